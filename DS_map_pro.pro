@@ -1,4 +1,4 @@
-QT += core gui widgets
+QT += core gui widgets concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -8,19 +8,49 @@ DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
 
 SOURCES += \
     main.cpp \
+    bench.cpp \
     mainwindow.cpp \
     mapview.cpp \
+    roadlayer.cpp \
     searchengine.cpp \
     router.cpp \
-    tilemanager.cpp
+    graphsnapshot.cpp \
+    spatialindex.cpp \
+    roadgraph.cpp \
+    nodeorder.cpp \
+    contractionhierarchy.cpp \
+    landmarks.cpp \
+    queryworkspace.cpp \
+    heaps.cpp \
+    isochrone.cpp \
+    clusterindex.cpp \
+    labelengine.cpp \
+    osmimporter.cpp \
+    tilemanager.cpp \
+    tilepack.cpp
 
 HEADERS += \
+    bench.h \
     mainwindow.h \
     mapview.h \
+    roadlayer.h \
     searchengine.h \
     router.h \
+    graphsnapshot.h \
+    spatialindex.h \
+    roadgraph.h \
+    nodeorder.h \
+    contractionhierarchy.h \
+    landmarks.h \
+    queryworkspace.h \
+    heaps.h \
+    isochrone.h \
+    clusterindex.h \
+    labelengine.h \
+    osmimporter.h \
     datatypes.h \
-    tilemanager.h
+    tilemanager.h \
+    tilepack.h
 
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
@@ -0,0 +1,433 @@
+#include "bench.h"
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include <QTextStream>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include "graphsnapshot.h"
+#include "queryworkspace.h"
+#include "roadgraph.h"
+#include "roadlayer.h"
+
+namespace {
+
+enum class MapKind {
+    Grid,       // Every road present, all at the same speed
+    RoadLike    // Highways and arterials on a local grid, a few roads missing
+};
+
+// Junctions about 220 m apart. The nodes are added in a shuffled order,
+// as an import adds them, and numbered by order. External ids are the
+// insertion order, so the same seed gives the same places in any order.
+RoadGraph generateMap(MapKind kind, int side, NodeOrder order)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> jitter(0.0, 0.0008);
+
+    std::vector<int> cells(side * side);
+    std::iota(cells.begin(), cells.end(), 0);
+    std::shuffle(cells.begin(), cells.end(), rng);
+
+    RoadGraphBuilder builder;
+    std::vector<int> nodeAt(cells.size());
+    for (int cell : cells) {
+        const int x = cell % side;
+        const int y = cell / side;
+        nodeAt[cell] = builder.addNode(28.6 + y * 0.002 + jitter(rng), 77.2 + x * 0.002 + jitter(rng));
+    }
+
+    auto speedOf = [kind](int line) {
+        if (kind == MapKind::Grid) {
+            return 50.0;
+        }
+        return line % 10 == 0 ? 100.0 : (line % 5 == 0 ? 60.0 : 30.0);
+    };
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            const int cell = y * side + x;
+            const bool keepRight = kind == MapKind::Grid || chance(rng) > 0.05;
+            const bool keepDown = kind == MapKind::Grid || chance(rng) > 0.05;
+            if (x + 1 < side && keepRight) {
+                builder.addRoad(nodeAt[cell], nodeAt[cell + 1], speedOf(y), "Street");
+            }
+            if (y + 1 < side && keepDown) {
+                builder.addRoad(nodeAt[cell], nodeAt[cell + side], speedOf(x), "Avenue");
+            }
+        }
+    }
+    return builder.build(order);
+}
+
+// The same count of random nodes for every graph of a given size, given as
+// internal ids of graph
+std::vector<int> randomNodes(const RoadGraph& graph, int count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> anyNode(0, graph.nodeCount() - 1);
+    std::vector<int> nodes(count);
+    for (int& node : nodes) {
+        node = graph.internalId(anyNode(rng));
+    }
+    return nodes;
+}
+
+// Mean milliseconds per call of run(i), for i counting up from 0, over at
+// least minRuns calls and 200 ms
+template <typename Run>
+double millisPerRun(int minRuns, Run run)
+{
+    QElapsedTimer clock;
+    clock.start();
+    int runs = 0;
+    while (runs < minRuns || clock.elapsed() < 200) {
+        run(runs++);
+    }
+    return clock.nsecsElapsed() / 1e6 / runs;
+}
+
+void report(QTextStream& out, const QString& variant, double ms, const QString& unit)
+{
+    out << QString("  %1 %2 ms %3\n").arg(variant, -34).arg(ms, 10, 'f', 4).arg(unit);
+    out.flush();
+}
+
+// Keeps the timed work from being optimized away
+volatile double sink = 0.0;
+
+using DistanceQueue = std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>,
+                                          std::greater<std::pair<double, int>>>;
+
+// Point-to-point Dijkstra on the calling thread's workspace, as the
+// router runs it; returns the cost
+double searchWorkspace(const RoadGraph& graph, int source, int target, HeapKind kind, RouteMetric metric)
+{
+    QueryWorkspace& ws = QueryWorkspace::local();
+    ws.startQuery(graph.nodeCount(), kind);
+    ws.setDistance(source, 0.0);
+    ws.push(source, 0.0, 0.0);
+    while (!ws.empty()) {
+        const QueryWorkspace::HeapEntry current = ws.top();
+        ws.pop();
+        if (current.cost > ws.distance(current.node)) {
+            continue;
+        }
+        if (current.node == target) {
+            break;
+        }
+        for (int e = graph.edgeBegin(current.node); e < graph.edgeEnd(current.node); e++) {
+            const int next = graph.edgeTarget(e);
+            const double cost = current.cost + graph.edgeCost(e, metric);
+            if (cost < ws.distance(next)) {
+                ws.setDistance(next, cost, current.node, e);
+                ws.push(next, cost, cost);
+            }
+        }
+    }
+    return ws.distance(target);
+}
+
+// The graph as it was stored before the CSR layout: a hash map from node id
+// to a vector of edges, each with its own name string
+void benchGraphLayout(QTextStream& out, int side)
+{
+    const RoadGraph graph = generateMap(MapKind::RoadLike, side, NodeOrder::Hilbert);
+    std::unordered_map<int, std::vector<Edge>> adjacency;
+    for (int u = 0; u < graph.nodeCount(); u++) {
+        std::vector<Edge>& edges = adjacency[u];
+        for (int e = graph.edgeBegin(u); e < graph.edgeEnd(u); e++) {
+            edges.push_back(Edge(graph.edgeTarget(e), graph.edgeDistance(e), graph.edgeSpeed(e),
+                                 graph.edgeRoadName(e)));
+        }
+    }
+
+    out << QString("Graph layout: one-to-all Dijkstra by distance, %1 nodes, %2 edges\n")
+               .arg(graph.nodeCount())
+               .arg(graph.edgeCount());
+
+    // Both searches keep distances in the same dense array, so only the
+    // way edges are reached differs
+    const std::vector<int> sources = randomNodes(graph, 16, 1);
+    std::vector<double> dist;
+    auto search = [&](int source, auto relaxAll) {
+        dist.assign(graph.nodeCount(), std::numeric_limits<double>::infinity());
+        DistanceQueue queue;
+        dist[source] = 0.0;
+        queue.push({0.0, source});
+        while (!queue.empty()) {
+            const auto current = queue.top();
+            queue.pop();
+            if (current.first <= dist[current.second]) {
+                relaxAll(current.second, current.first, queue);
+            }
+        }
+        sink += dist[graph.nodeCount() - 1];
+    };
+
+    const double mapMs = millisPerRun(sources.size(), [&](int i) {
+        search(sources[i % sources.size()], [&](int u, double cost, DistanceQueue& queue) {
+            for (const Edge& edge : adjacency.at(u)) {
+                const double next = cost + edge.distance;
+                if (next < dist[edge.toNode]) {
+                    dist[edge.toNode] = next;
+                    queue.push({next, edge.toNode});
+                }
+            }
+        });
+    });
+    const double csrMs = millisPerRun(sources.size(), [&](int i) {
+        search(sources[i % sources.size()], [&](int u, double cost, DistanceQueue& queue) {
+            for (int e = graph.edgeBegin(u); e < graph.edgeEnd(u); e++) {
+                const int target = graph.edgeTarget(e);
+                const double next = cost + graph.edgeDistance(e);
+                if (next < dist[target]) {
+                    dist[target] = next;
+                    queue.push({next, target});
+                }
+            }
+        });
+    });
+
+    report(out, "hash map of edge vectors", mapMs, "per search");
+    report(out, "CSR columns", csrMs, "per search");
+}
+
+// Short point-to-point searches on maps of growing size, with the
+// per-query hash maps the router used to fill for every node and with the
+// reused per-thread workspace
+void benchWorkspace(QTextStream& out, int side)
+{
+    out << "Query workspace: Dijkstra to a node about eight roads away\n";
+
+    for (int size : {side / 4, side / 2, side, side * 2}) {
+        const RoadGraph graph = generateMap(MapKind::RoadLike, size, NodeOrder::Hilbert);
+
+        // Targets reached by a short random walk, so the searches settle
+        // about the same number of nodes at every size
+        const std::vector<int> sources = randomNodes(graph, 64, 2);
+        std::vector<int> targets;
+        std::mt19937 rng(3);
+        for (int source : sources) {
+            int node = source;
+            for (int step = 0; step < 8 && graph.edgeEnd(node) > graph.edgeBegin(node); step++) {
+                const int degree = graph.edgeEnd(node) - graph.edgeBegin(node);
+                node = graph.edgeTarget(graph.edgeBegin(node) + static_cast<int>(rng() % degree));
+            }
+            targets.push_back(node);
+        }
+
+        const double mapMs = millisPerRun(4, [&](int i) {
+            const int source = sources[i % sources.size()];
+            const int target = targets[i % targets.size()];
+            std::unordered_map<int, double> distances;
+            std::unordered_map<int, int> previous;
+            for (int u = 0; u < graph.nodeCount(); u++) {
+                distances[u] = std::numeric_limits<double>::infinity();
+            }
+            DistanceQueue queue;
+            distances[source] = 0.0;
+            queue.push({0.0, source});
+            while (!queue.empty()) {
+                const auto current = queue.top();
+                queue.pop();
+                if (current.first > distances[current.second]) {
+                    continue;
+                }
+                if (current.second == target) {
+                    break;
+                }
+                for (int e = graph.edgeBegin(current.second); e < graph.edgeEnd(current.second); e++) {
+                    const int next = graph.edgeTarget(e);
+                    const double cost = current.first + graph.edgeDistance(e);
+                    if (cost < distances[next]) {
+                        distances[next] = cost;
+                        previous[next] = current.second;
+                        queue.push({cost, next});
+                    }
+                }
+            }
+            sink += distances[target];
+        });
+
+        const double workspaceMs = millisPerRun(sources.size(), [&](int i) {
+            sink += searchWorkspace(graph, sources[i % sources.size()], targets[i % targets.size()],
+                                    HeapKind::Binary, RouteMetric::Distance);
+        });
+
+        const QString map = QString("%1 nodes").arg(graph.nodeCount());
+        report(out, QString("per-query hash maps, %1").arg(map), mapMs, "per query");
+        report(out, QString("QueryWorkspace, %1").arg(map), workspaceMs, "per query");
+    }
+}
+
+// Long point-to-point searches by travel time with every queue the
+// searches can use, and with the std::priority_queue of 16-byte states and
+// lazy deletion the router had before
+void benchHeaps(QTextStream& out, int side)
+{
+    out << "Heaps: Dijkstra by travel time between random nodes\n";
+
+    struct Map {
+        const char* name;
+        MapKind kind;
+    };
+    for (const Map& map : {Map{"grid", MapKind::Grid}, Map{"road-like", MapKind::RoadLike}}) {
+        const RoadGraph graph = generateMap(map.kind, side, NodeOrder::Hilbert);
+        const std::vector<int> sources = randomNodes(graph, 16, 4);
+        const std::vector<int> targets = randomNodes(graph, 16, 5);
+
+        struct State {
+            int node;
+            double cost;
+            bool operator>(const State& other) const { return cost > other.cost; }
+        };
+        const double stateMs = millisPerRun(sources.size(), [&](int i) {
+            const int source = sources[i % sources.size()];
+            const int target = targets[i % targets.size()];
+            std::vector<double> dist(graph.nodeCount(), std::numeric_limits<double>::infinity());
+            std::priority_queue<State, std::vector<State>, std::greater<State>> queue;
+            dist[source] = 0.0;
+            queue.push({source, 0.0});
+            while (!queue.empty()) {
+                const State current = queue.top();
+                queue.pop();
+                if (current.cost > dist[current.node]) {
+                    continue;
+                }
+                if (current.node == target) {
+                    break;
+                }
+                for (int e = graph.edgeBegin(current.node); e < graph.edgeEnd(current.node); e++) {
+                    const int next = graph.edgeTarget(e);
+                    const double cost = current.cost + graph.edgeTravelTime(e);
+                    if (cost < dist[next]) {
+                        dist[next] = cost;
+                        queue.push({next, cost});
+                    }
+                }
+            }
+            sink += dist[target];
+        });
+        report(out, QString("%1, priority_queue").arg(map.name), stateMs, "per query");
+
+        struct Kind {
+            const char* name;
+            HeapKind kind;
+        };
+        for (const Kind& heap : {Kind{"binary heap", HeapKind::Binary}, Kind{"4-ary heap", HeapKind::FourAry},
+                                 Kind{"radix heap", HeapKind::Radix}}) {
+            const double ms = millisPerRun(sources.size(), [&](int i) {
+                sink += searchWorkspace(graph, sources[i % sources.size()], targets[i % targets.size()],
+                                        heap.kind, RouteMetric::TravelTime);
+            });
+            report(out, QString("%1, %2").arg(map.name, heap.name), ms, "per query");
+        }
+    }
+}
+
+// The same map numbered in import order and in each locality order, timed
+// on searches and on painting a window's worth of roads and junctions
+void benchNodeOrder(QTextStream& out, int side)
+{
+    out << QString("Node order: %1 x %1 road-like map\n").arg(side);
+
+    struct Order {
+        const char* name;
+        NodeOrder order;
+    };
+    for (const Order& order : {Order{"import order", NodeOrder::Insertion}, Order{"Hilbert", NodeOrder::Hilbert},
+                               Order{"breadth-first", NodeOrder::BreadthFirst},
+                               Order{"depth-first", NodeOrder::DepthFirst}}) {
+        const GraphSnapshotPtr snapshot = GraphSnapshot::create(generateMap(MapKind::RoadLike, side, order.order));
+        const RoadGraph& graph = snapshot->graph();
+
+        const std::vector<int> sources = randomNodes(graph, 16, 6);
+        const std::vector<int> targets = randomNodes(graph, 16, 7);
+        const double queryMs = millisPerRun(sources.size(), [&](int i) {
+            sink += searchWorkspace(graph, sources[i % sources.size()], targets[i % targets.size()],
+                                    HeapKind::FourAry, RouteMetric::TravelTime);
+        });
+        report(out, QString("%1, query").arg(order.name), queryMs, "per query");
+
+        // Windows of 1024 x 768 pixels at 0.2 pixels per world unit, about
+        // 25 x 19 junctions, centred on the same places in every order
+        const double scale = 0.2;
+        const RoadLayer roads(*snapshot);
+        const std::vector<int> centres = randomNodes(graph, 16, 8);
+        QImage image(1024, 768, QImage::Format_ARGB32_Premultiplied);
+        const double paintMs = millisPerRun(centres.size(), [&](int i) {
+            const QPointF centre = RoadLayer::toWorld(graph.coord(centres[i % centres.size()]));
+            const QSizeF size(image.width() / scale, image.height() / scale);
+            const QRectF area(centre - QPointF(size.width() / 2, size.height() / 2), size);
+
+            image.fill(Qt::white);
+            QPainter painter(&image);
+            painter.scale(scale, scale);
+            painter.translate(-area.topLeft());
+            roads.paint(painter, area, scale);
+
+            // Junctions are looked up and drawn by id, as the map view does
+            const GeoCoord corner1(-area.top() / 100000.0, area.left() / 100000.0);
+            const GeoCoord corner2(-area.bottom() / 100000.0, area.right() / 100000.0);
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(QColor(149, 165, 166));
+            for (int u : snapshot->spatialIndex().nodesInBox(corner1, corner2)) {
+                painter.drawEllipse(RoadLayer::toWorld(graph.coord(u)), 3 / scale, 3 / scale);
+            }
+        });
+        report(out, QString("%1, paint").arg(order.name), paintMs, "per window");
+    }
+}
+
+struct Suite {
+    const char* name;
+    const char* description;
+    void (*run)(QTextStream& out, int side);
+};
+
+const Suite Suites[] = {
+    {"csr", "CSR graph against the former hash map adjacency", benchGraphLayout},
+    {"workspace", "Short query latency against map size, hash maps and workspace", benchWorkspace},
+    {"heaps", "Priority queues on grid and road-like maps", benchHeaps},
+    {"order", "Queries and painting with import, Hilbert, BFS and DFS node order", benchNodeOrder}
+};
+
+} // namespace
+
+int runBenchmarks(const QStringList& args)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const QString name = args.size() > 2 ? args.at(2) : QString("all");
+    const int side = args.size() > 3 ? args.at(3).toInt() : 300;
+    if (args.size() > 4 || side < 10) {
+        err << "Usage: " << args.at(0) << " --bench [suite] [side]\n";
+        return 2;
+    }
+
+    if (name == "list") {
+        for (const Suite& suite : Suites) {
+            out << suite.name << "\t" << suite.description << "\n";
+        }
+        return 0;
+    }
+
+    bool found = false;
+    for (const Suite& suite : Suites) {
+        if (name == "all" || name == suite.name) {
+            suite.run(out, side);
+            found = true;
+        }
+    }
+    if (!found) {
+        err << "Unknown suite " << name << "; --bench list names them\n";
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <QStringList>
+
+// DS_map_pro --bench [suite] [side]
+//
+// Times the alternatives the routing and drawing code chose between, on
+// generated grid maps of side x side junctions (300 by default), and prints
+// one line per variant. Without a suite every one runs; "list" names them.
+int runBenchmarks(const QStringList& args);
+
+#endif // BENCH_H
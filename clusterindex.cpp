@@ -0,0 +1,190 @@
+#include "clusterindex.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+#include "roadlayer.h"
+
+namespace {
+
+double scaleForZoom(int zoom)
+{
+    return std::ldexp(1.0, zoom - 10);
+}
+
+qint64 cellKey(qint64 column, qint64 row)
+{
+    return (column << 32) ^ static_cast<quint32>(row);
+}
+
+// One greedy pass: every point not yet taken absorbs the untaken points
+// within radius of it
+std::vector<ClusterIndex::Cluster> mergeWithin(const std::vector<ClusterIndex::Cluster>& points,
+                                               double radius)
+{
+    // Cells one radius across, so neighbours lie in the 3 x 3 cells around
+    auto cellOf = [radius](double v) { return static_cast<qint64>(std::floor(v / radius)); };
+    std::unordered_map<qint64, std::vector<int>> grid;
+    for (int i = 0; i < static_cast<int>(points.size()); i++) {
+        grid[cellKey(cellOf(points[i].world.x()), cellOf(points[i].world.y()))].push_back(i);
+    }
+
+    std::vector<ClusterIndex::Cluster> merged;
+    std::vector<char> taken(points.size(), 0);
+    const double radius2 = radius * radius;
+    for (int i = 0; i < static_cast<int>(points.size()); i++) {
+        if (taken[i]) {
+            continue;
+        }
+        taken[i] = 1;
+
+        const ClusterIndex::Cluster& p = points[i];
+        double sumX = p.world.x() * p.count;
+        double sumY = p.world.y() * p.count;
+        int count = p.count;
+        bool absorbed = false;
+
+        const qint64 column = cellOf(p.world.x());
+        const qint64 row = cellOf(p.world.y());
+        for (qint64 dr = -1; dr <= 1; dr++) {
+            for (qint64 dc = -1; dc <= 1; dc++) {
+                auto cell = grid.find(cellKey(column + dc, row + dr));
+                if (cell == grid.end()) {
+                    continue;
+                }
+                for (int j : cell->second) {
+                    const ClusterIndex::Cluster& q = points[j];
+                    const double dx = q.world.x() - p.world.x();
+                    const double dy = q.world.y() - p.world.y();
+                    if (!taken[j] && dx * dx + dy * dy <= radius2) {
+                        taken[j] = 1;
+                        sumX += q.world.x() * q.count;
+                        sumY += q.world.y() * q.count;
+                        count += q.count;
+                        absorbed = true;
+                    }
+                }
+            }
+        }
+
+        if (absorbed) {
+            merged.push_back({QPointF(sumX / count, sumY / count), count, -1});
+        } else {
+            merged.push_back(p);
+        }
+    }
+    return merged;
+}
+
+} // namespace
+
+ClusterIndex::ClusterIndex()
+{
+}
+
+ClusterIndex::ClusterIndex(const GraphSnapshot& snapshot)
+    : ClusterIndex()
+{
+    const RoadGraph& graph = snapshot.graph();
+    std::vector<Cluster> places;
+    for (int u = 0; u < graph.nodeCount(); u++) {
+        if (graph.hasName(u) && !graph.nodeName(u).contains("Junction")) {
+            places.push_back({RoadLayer::toWorld(graph.coord(u)), 1, u});
+        }
+    }
+    if (places.empty()) {
+        return;
+    }
+
+    double minX = places[0].world.x(), maxX = minX;
+    double minY = places[0].world.y(), maxY = minY;
+    for (const Cluster& place : places) {
+        minX = std::min(minX, place.world.x());
+        maxX = std::max(maxX, place.world.x());
+        minY = std::min(minY, place.world.y());
+        maxY = std::max(maxY, place.world.y());
+    }
+    bounds = QRectF(QPointF(minX, minY), QPointF(maxX, maxY));
+
+    levels.resize(1 + MaxZoom - MinZoom + 1);
+    fileLevel(levels[0], std::move(places));
+    for (int zoom = MaxZoom; zoom >= MinZoom; zoom--) {
+        const Level& above = levels[MaxZoom - zoom];
+        fileLevel(levels[MaxZoom - zoom + 1], mergeWithin(above.points, Radius / scaleForZoom(zoom)));
+    }
+}
+
+void ClusterIndex::fileLevel(Level& level, std::vector<Cluster> points) const
+{
+    // About four points per cell, and never many more cells than points
+    const double n = static_cast<double>(points.size());
+    const double width = std::max(bounds.width(), 1.0);
+    const double height = std::max(bounds.height(), 1.0);
+    level.cellSize = std::max(std::sqrt(width * height * 4.0 / n), 1.0);
+    while ((width / level.cellSize + 1) * (height / level.cellSize + 1) > n + 16.0) {
+        level.cellSize *= 2.0;
+    }
+    level.columns = static_cast<int>(width / level.cellSize) + 1;
+    level.rows = static_cast<int>(height / level.cellSize) + 1;
+
+    std::vector<int> cells(points.size());
+    level.cellFirst.assign(level.columns * level.rows + 1, 0);
+    for (size_t i = 0; i < points.size(); i++) {
+        cells[i] = row(level, points[i].world.y()) * level.columns + column(level, points[i].world.x());
+        level.cellFirst[cells[i] + 1]++;
+    }
+    std::partial_sum(level.cellFirst.begin(), level.cellFirst.end(), level.cellFirst.begin());
+
+    level.points.resize(points.size());
+    std::vector<int> next(level.cellFirst.begin(), level.cellFirst.end() - 1);
+    for (size_t i = 0; i < points.size(); i++) {
+        level.points[next[cells[i]]++] = points[i];
+    }
+}
+
+void ClusterIndex::query(const QRectF& worldRect, double scale, std::vector<Cluster>& clusters) const
+{
+    clusters.clear();
+    const QRectF view = worldRect.normalized();
+    if (levels.empty() || view.right() < bounds.left() || view.left() > bounds.right() ||
+        view.bottom() < bounds.top() || view.top() > bounds.bottom()) {
+        return;
+    }
+
+    const Level& level = levelFor(scale);
+    const int firstColumn = column(level, view.left());
+    const int lastColumn = column(level, view.right());
+    for (int y = row(level, view.top()); y <= row(level, view.bottom()); y++) {
+        // The cells of one row are contiguous, and so are their points
+        const int end = level.cellFirst[y * level.columns + lastColumn + 1];
+        for (int i = level.cellFirst[y * level.columns + firstColumn]; i < end; i++) {
+            const QPointF& p = level.points[i].world;
+            if (p.x() >= view.left() && p.x() <= view.right() &&
+                p.y() >= view.top() && p.y() <= view.bottom()) {
+                clusters.push_back(level.points[i]);
+            }
+        }
+    }
+}
+
+const ClusterIndex::Level& ClusterIndex::levelFor(double scale) const
+{
+    // The finest zoom whose clusters are at least Radius apart on screen
+    const int zoom = static_cast<int>(std::floor(std::log2(scale) + 10.0 + 1e-9));
+    if (zoom > MaxZoom) {
+        return levels.front();
+    }
+    return levels[MaxZoom - std::max(zoom, MinZoom) + 1];
+}
+
+int ClusterIndex::column(const Level& level, double x) const
+{
+    return static_cast<int>(std::min(std::max(std::floor((x - bounds.left()) / level.cellSize), 0.0),
+                                     level.columns - 1.0));
+}
+
+int ClusterIndex::row(const Level& level, double y) const
+{
+    return static_cast<int>(std::min(std::max(std::floor((y - bounds.top()) / level.cellSize), 0.0),
+                                     level.rows - 1.0));
+}
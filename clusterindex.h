@@ -0,0 +1,62 @@
+#ifndef CLUSTERINDEX_H
+#define CLUSTERINDEX_H
+
+#include <QPointF>
+#include <QRectF>
+#include <vector>
+#include "graphsnapshot.h"
+
+// Named places merged into clusters for drawing zoomed out, built once per
+// graph snapshot.
+//
+// There is one level per zoom from MinZoom to MaxZoom, zoom z drawing at
+// 2^(z - 10) pixels per world unit like the road tiles. Going from MaxZoom
+// down, each level merges greedily the points of the level above that lie
+// within Radius pixels of a point not yet taken, at the merged points'
+// centroid weighted by count (the supercluster scheme). Beyond MaxZoom the
+// places are drawn one by one. Each level files its points in a grid, so a
+// viewport query reads a few runs of cells.
+class ClusterIndex {
+public:
+    static const int MinZoom = 4;
+    static const int MaxZoom = 14;
+    // Pixels within which points merge at a level's own scale
+    static constexpr double Radius = 40.0;
+
+    struct Cluster {
+        QPointF world;      // See RoadLayer::toWorld
+        int count;          // Places merged into it
+        int node;           // The place itself when count is 1, else -1
+    };
+
+    ClusterIndex();
+    explicit ClusterIndex(const GraphSnapshot& snapshot);
+
+    bool isEmpty() const { return levels.empty(); }
+    int placeCount() const { return levels.empty() ? 0 : static_cast<int>(levels.front().points.size()); }
+
+    // Replaces clusters with those in the world rectangle as drawn at scale
+    // pixels per world unit; single places have count 1
+    void query(const QRectF& worldRect, double scale, std::vector<Cluster>& clusters) const;
+
+private:
+    // Point p lies in cell c when cellFirst[c] <= p < cellFirst[c + 1]
+    struct Level {
+        std::vector<Cluster> points;
+        std::vector<int> cellFirst;
+        double cellSize = 1.0;
+        int columns = 0;
+        int rows = 0;
+    };
+
+    void fileLevel(Level& level, std::vector<Cluster> points) const;
+    const Level& levelFor(double scale) const;
+    int column(const Level& level, double x) const;
+    int row(const Level& level, double y) const;
+
+    QRectF bounds;
+    // The places unmerged, then zooms MaxZoom down to MinZoom
+    std::vector<Level> levels;
+};
+
+#endif // CLUSTERINDEX_H
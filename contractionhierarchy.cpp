@@ -0,0 +1,719 @@
+#include "contractionhierarchy.h"
+#include "queryworkspace.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QtConcurrent>
+#include <numeric>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const quint32 FileMagic = 0x43484D56; // "CHMV"
+const quint32 FileVersion = 1;
+
+// Witness searches give up after this many settled nodes; a missed witness
+// only costs an unnecessary shortcut, never a wrong distance. Priority
+// simulations run far more often than real contractions, so they get a
+// tighter budget.
+const int WitnessSettleLimit = 500;
+const int SimulationSettleLimit = 50;
+
+struct Arc {
+    int node;
+    double weight;
+    int middle;
+};
+
+struct Shortcut {
+    int from;
+    int to;
+    double weight;
+    int middle;
+};
+
+// Adds an arc or lowers the weight of an existing one to the same node
+void addArc(std::vector<Arc>& arcs, const Arc& arc)
+{
+    for (auto& existing : arcs) {
+        if (existing.node == arc.node) {
+            if (arc.weight < existing.weight) {
+                existing = arc;
+            }
+            return;
+        }
+    }
+    arcs.push_back(arc);
+}
+
+void removeArc(std::vector<Arc>& arcs, int node)
+{
+    for (size_t i = 0; i < arcs.size(); i++) {
+        if (arcs[i].node == node) {
+            arcs[i] = arcs.back();
+            arcs.pop_back();
+            return;
+        }
+    }
+}
+
+// Bounded local Dijkstra, one instance per worker thread
+struct WitnessSearch {
+    std::vector<double> dist;
+    std::vector<int> touched;
+    std::vector<char> isTarget;
+    std::vector<std::pair<double, int>> heap;
+
+    void run(const std::vector<std::vector<Arc>>& out, const std::vector<char>& blocked,
+             int source, int avoidNode, const std::vector<Arc>& targets,
+             double limit, int settleLimit)
+    {
+        using Entry = std::pair<double, int>;
+        const double inf = std::numeric_limits<double>::infinity();
+
+        if (dist.size() != out.size()) {
+            dist.assign(out.size(), inf);
+            isTarget.assign(out.size(), 0);
+        } else {
+            for (int node : touched) {
+                dist[node] = inf;
+            }
+        }
+        touched.clear();
+        heap.clear();
+
+        // The search can stop as soon as every target is settled
+        int pendingTargets = 0;
+        for (const Arc& target : targets) {
+            if (target.node != source && !isTarget[target.node]) {
+                isTarget[target.node] = 1;
+                pendingTargets++;
+            }
+        }
+
+        dist[source] = 0.0;
+        touched.push_back(source);
+        heap.push_back({0.0, source});
+
+        int settled = 0;
+        while (!heap.empty() && pendingTargets > 0) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+            Entry current = heap.back();
+            heap.pop_back();
+
+            if (current.first > dist[current.second]) {
+                continue;
+            }
+            if (current.first > limit || ++settled > settleLimit) {
+                break;
+            }
+            if (isTarget[current.second]) {
+                pendingTargets--;
+            }
+
+            for (const Arc& arc : out[current.second]) {
+                if (arc.node == avoidNode || blocked[arc.node]) {
+                    continue;
+                }
+                double newCost = current.first + arc.weight;
+                if (newCost < dist[arc.node]) {
+                    if (dist[arc.node] == inf) {
+                        touched.push_back(arc.node);
+                    }
+                    dist[arc.node] = newCost;
+                    heap.push_back({newCost, arc.node});
+                    std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+                }
+            }
+        }
+
+        for (const Arc& target : targets) {
+            isTarget[target.node] = 0;
+        }
+    }
+};
+
+thread_local WitnessSearch witness;
+
+// Mutable graph that shrinks as nodes are contracted
+struct ContractionGraph {
+    std::vector<std::vector<Arc>> out;
+    std::vector<std::vector<Arc>> in;
+    std::vector<char> contracted;
+    std::vector<char> inRound;  // Contracted in the current round, off limits to witnesses
+    std::vector<int> deletedNeighbours;
+    std::vector<int> priority;
+
+    // Shortcuts needed to contract v. Simulations only avoid v itself;
+    // real contractions also avoid every node of the current round.
+    void findShortcuts(int v, bool avoidRound, std::vector<Shortcut>& result)
+    {
+        const std::vector<char>& blocked = avoidRound ? inRound : contracted;
+
+        for (const Arc& inArc : in[v]) {
+            double maxOut = -1.0;
+            for (const Arc& outArc : out[v]) {
+                if (outArc.node != inArc.node) {
+                    maxOut = std::max(maxOut, outArc.weight);
+                }
+            }
+            if (maxOut < 0.0) {
+                continue;
+            }
+
+            witness.run(out, blocked, inArc.node, v, out[v], inArc.weight + maxOut,
+                        avoidRound ? WitnessSettleLimit : SimulationSettleLimit);
+
+            for (const Arc& outArc : out[v]) {
+                if (outArc.node == inArc.node) {
+                    continue;
+                }
+                double via = inArc.weight + outArc.weight;
+                if (witness.dist[outArc.node] > via) {
+                    result.push_back({inArc.node, outArc.node, via, v});
+                }
+            }
+        }
+    }
+
+    void updatePriority(int v)
+    {
+        std::vector<Shortcut> found;
+        findShortcuts(v, false, found);
+        int edgeDifference = static_cast<int>(found.size()) -
+                             static_cast<int>(in[v].size() + out[v].size());
+        priority[v] = 2 * edgeDifference + deletedNeighbours[v];
+    }
+
+    // Ties are broken by id so the order is strict
+    bool contractsBefore(int a, int b) const
+    {
+        return priority[a] < priority[b] || (priority[a] == priority[b] && a < b);
+    }
+
+    bool isLocalMinimum(int v) const
+    {
+        for (const Arc& arc : out[v]) {
+            if (!contractsBefore(v, arc.node)) return false;
+        }
+        for (const Arc& arc : in[v]) {
+            if (!contractsBefore(v, arc.node)) return false;
+        }
+        return true;
+    }
+};
+
+template<typename T>
+void writeVector(QDataStream& out, const std::vector<T>& values)
+{
+    out << static_cast<quint32>(values.size());
+    for (const T& value : values) {
+        out << value;
+    }
+}
+
+template<typename T>
+bool readVector(QDataStream& in, std::vector<T>& values, quint32 maxSize)
+{
+    quint32 size = 0;
+    in >> size;
+    if (in.status() != QDataStream::Ok || size > maxSize) {
+        return false;
+    }
+    values.resize(size);
+    for (T& value : values) {
+        in >> value;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+} // namespace
+
+ContractionHierarchy::ContractionHierarchy()
+    : hierarchyMetric(RouteMetric::Distance),
+    graphFingerprint(0),
+    shortcuts(0)
+{
+}
+
+void ContractionHierarchy::clear()
+{
+    *this = ContractionHierarchy();
+}
+
+quint64 ContractionHierarchy::fingerprint(const RoadGraph& graph, RouteMetric metric)
+{
+    // FNV-1a over the topology and the weights of the chosen metric
+    quint64 hash = 14695981039346656037ULL;
+    auto mix = [&hash](quint64 value) {
+        for (int i = 0; i < 8; i++) {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    mix(static_cast<quint64>(metric));
+    mix(static_cast<quint64>(graph.nodeCount()));
+    for (int u = 0; u < graph.nodeCount(); u++) {
+        mix(static_cast<quint64>(graph.edgeEnd(u)));
+    }
+    for (int e = 0; e < graph.edgeCount(); e++) {
+        double weight = graph.edgeCost(e, metric);
+        quint64 bits;
+        std::memcpy(&bits, &weight, sizeof(bits));
+        mix(static_cast<quint64>(graph.edgeTarget(e)));
+        mix(bits);
+    }
+    return hash;
+}
+
+bool ContractionHierarchy::build(const RoadGraph& graph, RouteMetric metric, QueryControl* control)
+{
+    clear();
+    hierarchyMetric = metric;
+    graphFingerprint = fingerprint(graph, metric);
+
+    const int nodeCount = graph.nodeCount();
+
+    ContractionGraph work;
+    work.out.resize(nodeCount);
+    work.in.resize(nodeCount);
+    work.contracted.assign(nodeCount, 0);
+    work.inRound.assign(nodeCount, 0);
+    work.deletedNeighbours.assign(nodeCount, 0);
+    work.priority.assign(nodeCount, 0);
+
+    for (int u = 0; u < nodeCount; u++) {
+        for (int e = graph.edgeBegin(u); e < graph.edgeEnd(u); e++) {
+            int v = graph.edgeTarget(e);
+            if (u == v) {
+                continue;
+            }
+            double weight = graph.edgeCost(e, metric);
+            addArc(work.out[u], {v, weight, -1});
+            addArc(work.in[v], {u, weight, -1});
+        }
+    }
+
+    std::vector<int> remaining(nodeCount);
+    std::iota(remaining.begin(), remaining.end(), 0);
+    QtConcurrent::blockingMap(remaining, [&work](int v) { work.updatePriority(v); });
+
+    std::vector<std::vector<Arc>> upArcs(nodeCount);
+    std::vector<std::vector<Arc>> downArcs(nodeCount);
+    rank.assign(nodeCount, 0);
+    int nextRank = 0;
+
+    while (!remaining.empty()) {
+        if (control) {
+            control->settledNodes.store(nextRank, std::memory_order_relaxed);
+            if (control->cancelled.load(std::memory_order_relaxed)) {
+                clear();
+                return false;
+            }
+        }
+
+        // Nodes that come before all their neighbours share no edges, so
+        // their witness searches and shortcuts can run side by side
+        std::vector<int> round = QtConcurrent::blockingFiltered(
+            remaining, [&work](int v) { return work.isLocalMinimum(v); });
+        for (int v : round) {
+            work.inRound[v] = 1;
+        }
+
+        std::vector<std::vector<Shortcut>> found(round.size());
+        std::vector<int> positions(round.size());
+        std::iota(positions.begin(), positions.end(), 0);
+        QtConcurrent::blockingMap(positions, [&](int i) {
+            work.findShortcuts(round[i], true, found[i]);
+        });
+
+        std::vector<int> touched;
+        for (int v : round) {
+            rank[v] = nextRank++;
+            upArcs[v] = work.out[v];
+            downArcs[v] = work.in[v];
+
+            for (const Arc& arc : work.out[v]) {
+                removeArc(work.in[arc.node], v);
+                work.deletedNeighbours[arc.node]++;
+                touched.push_back(arc.node);
+            }
+            for (const Arc& arc : work.in[v]) {
+                removeArc(work.out[arc.node], v);
+                work.deletedNeighbours[arc.node]++;
+                touched.push_back(arc.node);
+            }
+            work.out[v].clear();
+            work.in[v].clear();
+            work.contracted[v] = 1;
+            work.inRound[v] = 0;
+        }
+
+        for (const auto& list : found) {
+            for (const Shortcut& shortcut : list) {
+                addArc(work.out[shortcut.from], {shortcut.to, shortcut.weight, shortcut.middle});
+                addArc(work.in[shortcut.to], {shortcut.from, shortcut.weight, shortcut.middle});
+            }
+        }
+
+        remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+                                       [&work](int v) { return work.contracted[v] != 0; }),
+                        remaining.end());
+
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+        QtConcurrent::blockingMap(touched, [&work](int v) { work.updatePriority(v); });
+    }
+
+    // Flatten the recorded upward arcs into CSR arrays
+    upFirst.assign(nodeCount + 1, 0);
+    downFirst.assign(nodeCount + 1, 0);
+    for (int v = 0; v < nodeCount; v++) {
+        upFirst[v + 1] = upFirst[v] + static_cast<int>(upArcs[v].size());
+        downFirst[v + 1] = downFirst[v] + static_cast<int>(downArcs[v].size());
+    }
+
+    for (int v = 0; v < nodeCount; v++) {
+        for (const Arc& arc : upArcs[v]) {
+            upTargets.push_back(arc.node);
+            upWeights.push_back(arc.weight);
+            upMiddles.push_back(arc.middle);
+            if (arc.middle >= 0) shortcuts++;
+        }
+        for (const Arc& arc : downArcs[v]) {
+            downSources.push_back(arc.node);
+            downWeights.push_back(arc.weight);
+            downMiddles.push_back(arc.middle);
+            if (arc.middle >= 0) shortcuts++;
+        }
+    }
+    return true;
+}
+
+std::vector<int> ContractionHierarchy::findPath(int startNodeId, int endNodeId, QueryStats* stats,
+                                               HeapKind heapKind, QueryControl* control) const
+{
+    std::vector<int> path;
+    const int nodeCount = static_cast<int>(rank.size());
+    if (startNodeId < 0 || startNodeId >= nodeCount || endNodeId < 0 || endNodeId >= nodeCount) {
+        return path;
+    }
+
+    // Slot 0 searches upwards from the start, 1 upwards from the end over
+    // reversed edges. For the backward side the parent is the next node
+    // on the way to the end. The parent edge slot holds the shortcut middle.
+    QueryWorkspace* ws[2] = {&QueryWorkspace::local(0), &QueryWorkspace::local(1)};
+    ws[0]->startQuery(nodeCount, heapKind);
+    ws[1]->startQuery(nodeCount, heapKind);
+
+    ws[0]->setDistance(startNodeId, 0.0);
+    ws[1]->setDistance(endNodeId, 0.0);
+    ws[0]->push(startNodeId, 0.0, 0.0);
+    ws[1]->push(endNodeId, 0.0, 0.0);
+
+    double best = std::numeric_limits<double>::infinity();
+    int meetingNode = -1;
+    int settled = 0;
+
+    while (!ws[0]->empty() || !ws[1]->empty()) {
+        int side;
+        if (ws[0]->empty()) {
+            side = 1;
+        } else if (ws[1]->empty()) {
+            side = 0;
+        } else {
+            side = ws[0]->top().cost <= ws[1]->top().cost ? 0 : 1;
+        }
+
+        QueryWorkspace& own = *ws[side];
+        QueryWorkspace::HeapEntry current = own.top();
+        own.pop();
+
+        if (current.cost > own.distance(current.node)) {
+            continue;
+        }
+        // Upward paths only get longer, so this side cannot improve on best
+        if (current.cost >= best) {
+            own.clearQueue();
+            continue;
+        }
+
+        settled++;
+        if (control && control->poll(settled)) {
+            return path;
+        }
+
+        const int u = current.node;
+        double through = current.cost + ws[1 - side]->distance(u);
+        if (through < best) {
+            best = through;
+            meetingNode = u;
+        }
+
+        const int begin = side == 0 ? upFirst[u] : downFirst[u];
+        const int end = side == 0 ? upFirst[u + 1] : downFirst[u + 1];
+
+        for (int i = begin; i < end; i++) {
+            int next = side == 0 ? upTargets[i] : downSources[i];
+            double newCost = current.cost + (side == 0 ? upWeights[i] : downWeights[i]);
+            if (stats) stats->relaxedEdges++;
+
+            if (newCost < own.distance(next)) {
+                own.setDistance(next, newCost, u, side == 0 ? upMiddles[i] : downMiddles[i]);
+                own.push(next, newCost, newCost);
+            }
+        }
+    }
+
+    if (stats) stats->settledNodes += settled;
+    if (meetingNode < 0) {
+        return path;
+    }
+
+    // Collect the hierarchy edges on both halves, then unpack each one
+    std::vector<Shortcut> hops;
+    for (int node = meetingNode; node != startNodeId; node = ws[0]->parent(node)) {
+        hops.push_back({ws[0]->parent(node), node, 0.0, ws[0]->parentEdge(node)});
+    }
+    std::reverse(hops.begin(), hops.end());
+    for (int node = meetingNode; node != endNodeId; node = ws[1]->parent(node)) {
+        hops.push_back({node, ws[1]->parent(node), 0.0, ws[1]->parentEdge(node)});
+    }
+
+    path.push_back(startNodeId);
+    for (const Shortcut& hop : hops) {
+        unpack(hop.from, hop.to, hop.middle, path);
+    }
+    return path;
+}
+
+int ContractionHierarchy::findMiddle(int fromNode, int toNode) const
+{
+    // The edge is stored at whichever endpoint was contracted first
+    if (rank[fromNode] < rank[toNode]) {
+        for (int i = upFirst[fromNode]; i < upFirst[fromNode + 1]; i++) {
+            if (upTargets[i] == toNode) return upMiddles[i];
+        }
+    } else {
+        for (int i = downFirst[toNode]; i < downFirst[toNode + 1]; i++) {
+            if (downSources[i] == fromNode) return downMiddles[i];
+        }
+    }
+    return -1;
+}
+
+void ContractionHierarchy::unpack(int fromNode, int toNode, int middle, std::vector<int>& path) const
+{
+    if (middle < 0) {
+        path.push_back(toNode);
+        return;
+    }
+    unpack(fromNode, middle, findMiddle(fromNode, middle), path);
+    unpack(middle, toNode, findMiddle(middle, toNode), path);
+}
+
+void ContractionHierarchy::upwardSearch(int origin, bool backward, HeapKind heapKind,
+                                        std::vector<Settled>& settled) const
+{
+    settled.clear();
+
+    QueryWorkspace& ws = QueryWorkspace::local();
+    ws.startQuery(static_cast<int>(rank.size()), heapKind);
+    ws.setDistance(origin, 0.0);
+    ws.push(origin, 0.0, 0.0);
+
+    while (!ws.empty()) {
+        QueryWorkspace::HeapEntry current = ws.top();
+        ws.pop();
+
+        const int u = current.node;
+        if (current.cost > ws.distance(u)) {
+            continue;
+        }
+        settled.push_back({u, current.cost});
+
+        const int begin = backward ? downFirst[u] : upFirst[u];
+        const int end = backward ? downFirst[u + 1] : upFirst[u + 1];
+        for (int i = begin; i < end; i++) {
+            int next = backward ? downSources[i] : upTargets[i];
+            double newCost = current.cost + (backward ? downWeights[i] : upWeights[i]);
+            if (newCost < ws.distance(next)) {
+                ws.setDistance(next, newCost);
+                ws.push(next, newCost, newCost);
+            }
+        }
+    }
+}
+
+DistanceMatrix ContractionHierarchy::distanceTable(const std::vector<int>& sources,
+                                                   const std::vector<int>& targets,
+                                                   HeapKind heapKind) const
+{
+    DistanceMatrix matrix;
+    matrix.rows = static_cast<int>(sources.size());
+    matrix.columns = static_cast<int>(targets.size());
+    matrix.values.assign(sources.size() * targets.size(), std::numeric_limits<double>::infinity());
+
+    const int nodeCount = static_cast<int>(rank.size());
+    auto valid = [nodeCount](int node) { return node >= 0 && node < nodeCount; };
+
+    // Backward searches, one per target column
+    std::vector<int> columns(targets.size());
+    std::iota(columns.begin(), columns.end(), 0);
+    std::vector<std::vector<Settled>> reached(targets.size());
+
+    QtConcurrent::blockingMap(columns, [&](int column) {
+        if (valid(targets[column])) {
+            upwardSearch(targets[column], true, heapKind, reached[column]);
+        }
+    });
+
+    // Gather the search spaces into per-node buckets in CSR form
+    struct BucketEntry {
+        int column;
+        double cost;
+    };
+    std::vector<int> bucketFirst(nodeCount + 1, 0);
+    for (const auto& space : reached) {
+        for (const Settled& entry : space) {
+            bucketFirst[entry.node + 1]++;
+        }
+    }
+    std::partial_sum(bucketFirst.begin(), bucketFirst.end(), bucketFirst.begin());
+
+    std::vector<BucketEntry> buckets(bucketFirst[nodeCount]);
+    std::vector<int> fill(bucketFirst.begin(), bucketFirst.end() - 1);
+    for (int column = 0; column < matrix.columns; column++) {
+        for (const Settled& entry : reached[column]) {
+            buckets[fill[entry.node]++] = {column, entry.cost};
+        }
+    }
+    reached.clear();
+
+    // Forward searches fill one row each, so rows never share output
+    std::vector<int> rows(sources.size());
+    std::iota(rows.begin(), rows.end(), 0);
+
+    QtConcurrent::blockingMap(rows, [&](int row) {
+        if (!valid(sources[row])) {
+            return;
+        }
+
+        std::vector<Settled> space;
+        upwardSearch(sources[row], false, heapKind, space);
+
+        double* out = &matrix.values[static_cast<size_t>(row) * matrix.columns];
+        for (const Settled& entry : space) {
+            for (int i = bucketFirst[entry.node]; i < bucketFirst[entry.node + 1]; i++) {
+                out[buckets[i].column] = std::min(out[buckets[i].column], entry.cost + buckets[i].cost);
+            }
+        }
+    });
+
+    return matrix;
+}
+
+bool ContractionHierarchy::save(const QString& path) const
+{
+    if (isEmpty()) {
+        return false;
+    }
+
+    // Written aside and renamed over the old file once complete, so a
+    // failed or interrupted save never leaves half a hierarchy behind
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << FileMagic << FileVersion
+        << static_cast<qint32>(hierarchyMetric) << graphFingerprint
+        << static_cast<qint32>(shortcuts);
+
+    writeVector(out, rank);
+    writeVector(out, upFirst);
+    writeVector(out, upTargets);
+    writeVector(out, upWeights);
+    writeVector(out, upMiddles);
+    writeVector(out, downFirst);
+    writeVector(out, downSources);
+    writeVector(out, downWeights);
+    writeVector(out, downMiddles);
+
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+bool ContractionHierarchy::load(const QString& path, const RoadGraph& graph)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 metricValue = 0;
+    quint64 storedFingerprint = 0;
+    qint32 storedShortcuts = 0;
+    in >> magic >> version >> metricValue >> storedFingerprint >> storedShortcuts;
+
+    if (magic != FileMagic || version != FileVersion ||
+        (metricValue != static_cast<qint32>(RouteMetric::Distance) &&
+         metricValue != static_cast<qint32>(RouteMetric::TravelTime))) {
+        return false;
+    }
+
+    RouteMetric storedMetric = static_cast<RouteMetric>(metricValue);
+    if (storedFingerprint != fingerprint(graph, storedMetric)) {
+        return false;
+    }
+
+    ContractionHierarchy loaded;
+    loaded.hierarchyMetric = storedMetric;
+    loaded.graphFingerprint = storedFingerprint;
+    loaded.shortcuts = storedShortcuts;
+
+    const quint32 maxSize = std::numeric_limits<qint32>::max();
+    if (!readVector(in, loaded.rank, maxSize) ||
+        !readVector(in, loaded.upFirst, maxSize) ||
+        !readVector(in, loaded.upTargets, maxSize) ||
+        !readVector(in, loaded.upWeights, maxSize) ||
+        !readVector(in, loaded.upMiddles, maxSize) ||
+        !readVector(in, loaded.downFirst, maxSize) ||
+        !readVector(in, loaded.downSources, maxSize) ||
+        !readVector(in, loaded.downWeights, maxSize) ||
+        !readVector(in, loaded.downMiddles, maxSize)) {
+        return false;
+    }
+
+    // The fingerprint only shows that the file was written for this graph,
+    // so the columns are checked like a graph file's before any query
+    // indexes with them. Middles of -1 mark original edges.
+    const size_t nodeCount = graph.nodeCount();
+    const qint64 nodes = graph.nodeCount();
+    const bool valid =
+        loaded.rank.size() == nodeCount &&
+        loaded.upFirst.size() == nodeCount + 1 && loaded.downFirst.size() == nodeCount + 1 &&
+        loaded.upWeights.size() == loaded.upTargets.size() &&
+        loaded.upMiddles.size() == loaded.upTargets.size() &&
+        loaded.downWeights.size() == loaded.downSources.size() &&
+        loaded.downMiddles.size() == loaded.downSources.size() &&
+        isOffsetColumn(loaded.upFirst, loaded.upTargets.size()) &&
+        isOffsetColumn(loaded.downFirst, loaded.downSources.size()) &&
+        isInRange(loaded.rank, 0, nodes) &&
+        isInRange(loaded.upTargets, 0, nodes) &&
+        isInRange(loaded.downSources, 0, nodes) &&
+        isInRange(loaded.upMiddles, -1, nodes) &&
+        isInRange(loaded.downMiddles, -1, nodes);
+    if (!valid) {
+        return false;
+    }
+
+    *this = loaded;
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef CONTRACTIONHIERARCHY_H
+#define CONTRACTIONHIERARCHY_H
+
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+#include "datatypes.h"
+#include "roadgraph.h"
+#include "heaps.h"
+
+// Contraction hierarchy over a RoadGraph for one metric.
+//
+// Preprocessing contracts nodes in order of importance (twice the edge difference
+// plus already contracted neighbours), adding a shortcut u->x whenever the
+// path u->v->x through the contracted node v has no equally short witness.
+// Independent sets of nodes are contracted in parallel rounds. Queries run
+// a bidirectional Dijkstra that only follows edges towards higher ranked
+// nodes, then unpack shortcuts back into the original node sequence.
+class ContractionHierarchy {
+public:
+    ContractionHierarchy();
+
+    // Reports the nodes contracted so far through control, and gives up
+    // between rounds once it is cancelled, returning false with the
+    // hierarchy left empty
+    bool build(const RoadGraph& graph, RouteMetric metric, QueryControl* control = nullptr);
+    void clear();
+
+    bool isEmpty() const { return rank.empty(); }
+    RouteMetric metric() const { return hierarchyMetric; }
+    int shortcutCount() const { return shortcuts; }
+
+    // Node ids from start to end, empty when the end is unreachable
+    std::vector<int> findPath(int startNodeId, int endNodeId, QueryStats* stats = nullptr,
+                              HeapKind heapKind = HeapKind::FourAry,
+                              QueryControl* control = nullptr) const;
+
+    // Costs from every source to every target with the bucket-based
+    // many-to-many algorithm: one backward upward search per target leaves
+    // (target, cost) entries in a bucket at each node it settles, then one
+    // forward upward search per source scans the buckets of its settled
+    // nodes. Both phases run in parallel. Invalid ids give infinite rows or
+    // columns.
+    DistanceMatrix distanceTable(const std::vector<int>& sources, const std::vector<int>& targets,
+                                 HeapKind heapKind = HeapKind::FourAry) const;
+
+    // The file records a fingerprint of the graph it was built for;
+    // loading only succeeds when it matches the given graph.
+    bool save(const QString& path) const;
+    bool load(const QString& path, const RoadGraph& graph);
+
+    static quint64 fingerprint(const RoadGraph& graph, RouteMetric metric);
+
+private:
+    struct Settled {
+        int node;
+        double cost;
+    };
+
+    // Every node reachable upwards from origin with its cost, over up edges
+    // or, when backward is set, over down edges against their direction
+    void upwardSearch(int origin, bool backward, HeapKind heapKind, std::vector<Settled>& settled) const;
+
+    int findMiddle(int fromNode, int toNode) const;
+    void unpack(int fromNode, int toNode, int middle, std::vector<int>& path) const;
+
+    RouteMetric hierarchyMetric;
+    quint64 graphFingerprint;
+    int shortcuts;
+
+    std::vector<int> rank;
+
+    // Upward edges in CSR form. "up" holds u->x with rank[x] > rank[u];
+    // "down" holds, at node x, the original-direction edges u->x with
+    // rank[u] > rank[x], walked backwards by the reverse search.
+    // A middle node of -1 marks an original edge, anything else a shortcut.
+    std::vector<int> upFirst;
+    std::vector<int> upTargets;
+    std::vector<double> upWeights;
+    std::vector<int> upMiddles;
+
+    std::vector<int> downFirst;
+    std::vector<int> downSources;
+    std::vector<double> downWeights;
+    std::vector<int> downMiddles;
+};
+
+#endif // CONTRACTIONHIERARCHY_H
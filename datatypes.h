@@ -3,9 +3,12 @@
 
 #include <QString>
 #include <QPointF>
+#include <QtGlobal>
 #include <vector>
 #include <unordered_map>
+#include <atomic>
 #include <cmath>
+#include <algorithm>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -34,6 +37,52 @@ struct GeoCoord {
     }
 };
 
+// Coordinate in whole 1e-7 degrees, about a centimetre of resolution. This
+// is how RoadGraph stores node positions, in memory and on disk.
+struct FixedCoord {
+    qint32 lat;
+    qint32 lon;
+
+    static FixedCoord fromGeo(const GeoCoord& coord) {
+        return {static_cast<qint32>(std::lround(coord.lat * 1e7)),
+                static_cast<qint32>(std::lround(coord.lon * 1e7))};
+    }
+
+    GeoCoord toGeo() const { return GeoCoord(lat * 1e-7, lon * 1e-7); }
+};
+
+// Edge weights are stored as whole decimetres and deciseconds. Rounding up
+// keeps a stored length at least the straight-line distance between its
+// ends, which the A* bounds rely on.
+inline quint32 toTenths(double value) {
+    return static_cast<quint32>(std::ceil(std::min(std::max(value * 10.0 - 1e-6, 0.0), 4294967295.0)));
+}
+
+inline quint32 toDecimetres(double meters) { return toTenths(meters); }
+inline quint32 toDeciseconds(double seconds) { return toTenths(seconds); }
+
+// Functional class of a road, most important first
+enum class RoadClass : quint8 {
+    Motorway,
+    Trunk,
+    Primary,
+    Secondary,
+    Tertiary,
+    Local,
+    Service
+};
+
+// Class for roads known only by their speed in km/h
+inline RoadClass roadClassForSpeed(double speed) {
+    if (speed >= 100.0) return RoadClass::Motorway;
+    if (speed >= 80.0) return RoadClass::Trunk;
+    if (speed >= 65.0) return RoadClass::Primary;
+    if (speed >= 50.0) return RoadClass::Secondary;
+    if (speed >= 40.0) return RoadClass::Tertiary;
+    if (speed >= 25.0) return RoadClass::Local;
+    return RoadClass::Service;
+}
+
 // Road network node
 struct Node {
     int id;
@@ -50,23 +99,61 @@ struct Edge {
     double distance;
     double speed;
     QString roadName;
+    RoadClass roadClass;
 
     Edge(int to, double dist, double spd = 50.0, const QString& name = QString())
-        : toNode(to), distance(dist), speed(spd), roadName(name) {}
+        : toNode(to), distance(dist), speed(spd), roadName(name),
+          roadClass(roadClassForSpeed(spd)) {}
 
     double travelTime() const {
         return distance / (speed * 1000.0 / 3600.0);
     }
 };
 
-// Graph structure
-using AdjacencyList = std::unordered_map<int, std::vector<Edge>>;
+// Edge weight minimised by a route query
+enum class RouteMetric {
+    Distance,   // Meters, Edge::distance
+    TravelTime  // Seconds, Edge::travelTime()
+};
+
+// Work done by the most recent route query
+struct QueryStats {
+    int settledNodes = 0;
+    int relaxedEdges = 0;
+};
+
+// Shared between a running search and whoever started it. Searches call
+// poll() as they settle nodes, which publishes their progress and tells them
+// whether to give up.
+struct QueryControl {
+    std::atomic<bool> cancelled{false};
+    std::atomic<int> settledNodes{0};
+
+    bool poll(int settled) {
+        if ((settled & 255) != 0) {
+            return false;
+        }
+        settledNodes.store(settled, std::memory_order_relaxed);
+        return cancelled.load(std::memory_order_relaxed);
+    }
+};
+
+// Dense many-to-many result, one row per source and one column per target.
+// Unreachable pairs hold infinity.
+struct DistanceMatrix {
+    int rows = 0;
+    int columns = 0;
+    std::vector<double> values;     // values[row * columns + column]
+
+    double at(int row, int column) const { return values[row * columns + column]; }
+};
 
-// Route step
+// Route step: one run along the same road, ending at location
 struct RouteStep {
     QString instruction;
     double distance;
     GeoCoord location;
+    std::vector<GeoCoord> shape;    // Points passed before location, in order
 };
 
 // Tile coordinates
@@ -81,31 +168,22 @@ struct TileCoord {
     }
 };
 
-// Hash function for TileCoord
+// Hash function for TileCoord. Mixes all 32 bits of x and y, which may be
+// negative, so tiles at any zoom hash apart.
 namespace std {
 template<>
 struct hash<TileCoord> {
     size_t operator()(const TileCoord& t) const {
-        return ((static_cast<size_t>(t.zoom) << 20) |
-                (static_cast<size_t>(t.x) << 10) |
-                static_cast<size_t>(t.y));
+        quint64 key = (static_cast<quint64>(static_cast<quint32>(t.x)) << 32) |
+                      static_cast<quint32>(t.y);
+        key ^= static_cast<quint64>(static_cast<quint32>(t.zoom)) * 0x9E3779B97F4A7C15ull;
+
+        // splitmix64 finalizer
+        key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+        key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+        return static_cast<size_t>(key ^ (key >> 31));
     }
 };
 }
 
-// Trie node for search
-struct TrieNode {
-    std::unordered_map<QChar, TrieNode*> children;
-    bool isEndOfWord;
-    int nodeId;
-
-    TrieNode() : isEndOfWord(false), nodeId(-1) {}
-
-    ~TrieNode() {
-        for (auto& pair : children) {
-            delete pair.second;
-        }
-    }
-};
-
 #endif // DATATYPES_H
@@ -0,0 +1,20 @@
+#include "graphsnapshot.h"
+#include <atomic>
+
+namespace {
+
+std::atomic<quint64> nextVersion(1);
+
+} // namespace
+
+GraphSnapshot::GraphSnapshot(RoadGraph graph)
+    : roadGraph(std::move(graph)),
+    index(roadGraph),
+    snapshotVersion(nextVersion++)
+{
+}
+
+GraphSnapshotPtr GraphSnapshot::create(RoadGraph graph)
+{
+    return GraphSnapshotPtr(new GraphSnapshot(std::move(graph)));
+}
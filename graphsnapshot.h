@@ -0,0 +1,45 @@
+#ifndef GRAPHSNAPSHOT_H
+#define GRAPHSNAPSHOT_H
+
+#include <QtGlobal>
+#include <memory>
+#include "roadgraph.h"
+#include "spatialindex.h"
+
+class GraphSnapshot;
+using GraphSnapshotPtr = std::shared_ptr<const GraphSnapshot>;
+
+// Immutable road network shared by the router, the map view and the search
+// index. The graph may be backed by a mapped file, which stays mapped for
+// as long as any snapshot refers to it.
+//
+// Components hold it through GraphSnapshotPtr and never copy the graph.
+// Loading a new network publishes a new snapshot; readers still working
+// on the old one keep it alive until they finish, so a reload never has to
+// wait for or interrupt them.
+class GraphSnapshot {
+public:
+    static GraphSnapshotPtr create(RoadGraph graph);
+
+    const RoadGraph& graph() const { return roadGraph; }
+    // Transposed edges for backward searches
+    const ReverseIndex& reverse() const { return roadGraph.reverse(); }
+    // Fastest edge in meters per second
+    double maxSpeed() const { return roadGraph.maxSpeed(); }
+    // Nearest nodes and roads to a position, built with the snapshot
+    const SpatialIndex& spatialIndex() const { return index; }
+    // Distinct for every snapshot created, increasing
+    quint64 version() const { return snapshotVersion; }
+
+    GraphSnapshot(const GraphSnapshot&) = delete;
+    GraphSnapshot& operator=(const GraphSnapshot&) = delete;
+
+private:
+    explicit GraphSnapshot(RoadGraph graph);
+
+    RoadGraph roadGraph;
+    SpatialIndex index;
+    quint64 snapshotVersion;
+};
+
+#endif // GRAPHSNAPSHOT_H
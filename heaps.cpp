@@ -0,0 +1,172 @@
+#include "heaps.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cstring>
+
+void BinaryHeap::push(const QueueEntry& entry)
+{
+    items.push_back(entry);
+    std::push_heap(items.begin(), items.end(), std::greater<QueueEntry>());
+}
+
+void BinaryHeap::pop()
+{
+    std::pop_heap(items.begin(), items.end(), std::greater<QueueEntry>());
+    items.pop_back();
+}
+
+void IndexedHeap::reserve(int nodeCount)
+{
+    if (static_cast<int>(position.size()) < nodeCount) {
+        position.resize(nodeCount, -1);
+    }
+}
+
+void IndexedHeap::clear()
+{
+    // Only queued nodes have a position, so this is bounded by the work done
+    for (const QueueEntry& entry : items) {
+        position[entry.node] = -1;
+    }
+    items.clear();
+}
+
+void IndexedHeap::push(const QueueEntry& entry)
+{
+    const int index = position[entry.node];
+    if (index < 0) {
+        items.push_back(entry);
+        siftUp(static_cast<int>(items.size()) - 1, entry);
+    } else if (entry.key < items[index].key) {
+        siftUp(index, entry);
+    } else {
+        items[index].cost = entry.cost;
+    }
+}
+
+void IndexedHeap::pop()
+{
+    position[items.front().node] = -1;
+
+    QueueEntry last = items.back();
+    items.pop_back();
+    if (!items.empty()) {
+        siftDown(0, last);
+    }
+}
+
+void IndexedHeap::siftUp(int index, QueueEntry entry)
+{
+    // Move parents down into the hole until entry fits
+    while (index > 0) {
+        const int parent = (index - 1) / 4;
+        if (!(items[parent].key > entry.key)) {
+            break;
+        }
+        items[index] = items[parent];
+        position[items[index].node] = index;
+        index = parent;
+    }
+    items[index] = entry;
+    position[entry.node] = index;
+}
+
+void IndexedHeap::siftDown(int index, QueueEntry entry)
+{
+    const int size = static_cast<int>(items.size());
+
+    while (true) {
+        const int first = index * 4 + 1;
+        if (first >= size) {
+            break;
+        }
+
+        int smallest = first;
+        const int end = std::min(first + 4, size);
+        for (int child = first + 1; child < end; child++) {
+            if (items[child].key < items[smallest].key) {
+                smallest = child;
+            }
+        }
+
+        if (!(items[smallest].key < entry.key)) {
+            break;
+        }
+        items[index] = items[smallest];
+        position[items[index].node] = index;
+        index = smallest;
+    }
+    items[index] = entry;
+    position[entry.node] = index;
+}
+
+RadixHeap::RadixHeap()
+    : last(0),
+    count(0)
+{
+}
+
+quint64 RadixHeap::bitsOf(double key)
+{
+    // Positive IEEE doubles order the same as their bit patterns
+    if (!(key > 0.0)) {
+        return 0;
+    }
+    quint64 bits;
+    std::memcpy(&bits, &key, sizeof(bits));
+    return bits;
+}
+
+int RadixHeap::bucketFor(quint64 bits) const
+{
+    if (bits <= last) {
+        return 0;
+    }
+    return 64 - qCountLeadingZeroBits(bits ^ last);
+}
+
+void RadixHeap::push(const QueueEntry& entry)
+{
+    buckets[bucketFor(bitsOf(entry.key))].push_back(entry);
+    count++;
+}
+
+const QueueEntry& RadixHeap::top()
+{
+    if (buckets[0].empty()) {
+        int i = 1;
+        while (buckets[i].empty()) {
+            i++;
+        }
+
+        // The smallest key of the first non-empty bucket becomes the new
+        // reference; everything else in that bucket then lands lower down
+        quint64 smallest = bitsOf(buckets[i].front().key);
+        for (const QueueEntry& entry : buckets[i]) {
+            smallest = std::min(smallest, bitsOf(entry.key));
+        }
+        last = std::max(last, smallest);
+
+        for (const QueueEntry& entry : buckets[i]) {
+            buckets[bucketFor(bitsOf(entry.key))].push_back(entry);
+        }
+        buckets[i].clear();
+    }
+    return buckets[0].back();
+}
+
+void RadixHeap::pop()
+{
+    top();
+    buckets[0].pop_back();
+    count--;
+}
+
+void RadixHeap::clear()
+{
+    for (auto& bucket : buckets) {
+        bucket.clear();
+    }
+    last = 0;
+    count = 0;
+}
@@ -0,0 +1,90 @@
+#ifndef HEAPS_H
+#define HEAPS_H
+
+#include <QtGlobal>
+#include <vector>
+#include <functional>
+
+// Priority queue implementations for the shortest path searches
+enum class HeapKind {
+    Binary,     // std heap algorithms, decrease-key by pushing duplicates
+    FourAry,    // Addressable 4-ary heap with real decrease-key
+    Radix       // Monotone radix heap, keys must never drop below the last pop
+};
+
+struct QueueEntry {
+    double key;     // Queue priority, cost plus any lower bound
+    double cost;
+    int node;
+
+    bool operator>(const QueueEntry& other) const {
+        return key > other.key;
+    }
+};
+
+// Binary heap with lazy deletion. A node can be queued several times; the
+// search skips entries whose cost is no longer the node's distance.
+class BinaryHeap {
+public:
+    bool empty() const { return items.empty(); }
+    const QueueEntry& top() const { return items.front(); }
+    void push(const QueueEntry& entry);
+    void pop();
+    void clear() { items.clear(); }
+
+private:
+    std::vector<QueueEntry> items;
+};
+
+// 4-ary heap addressed by node id. Pushing a node that is already queued
+// lowers its key in place, so each node occupies at most one slot and the
+// heap never holds stale entries. The shallower tree and four children per
+// cache line make sift-down cheaper than in a binary heap.
+class IndexedHeap {
+public:
+    // Node ids below nodeCount may be pushed
+    void reserve(int nodeCount);
+
+    bool empty() const { return items.empty(); }
+    const QueueEntry& top() const { return items.front(); }
+    bool contains(int node) const { return position[node] >= 0; }
+    void push(const QueueEntry& entry);
+    void pop();
+    void clear();
+
+private:
+    void siftUp(int index, QueueEntry entry);
+    void siftDown(int index, QueueEntry entry);
+
+    std::vector<QueueEntry> items;
+    std::vector<int> position;     // Slot in items per node, -1 when absent
+};
+
+// Radix heap over the bit pattern of non-negative double keys, which sorts
+// like the keys themselves. Bucket i holds keys whose highest bit differing
+// from the last extracted key is bit i - 1, so each entry only moves to
+// lower buckets and is touched O(64) times at most. Only valid when popped
+// keys never decrease, as in Dijkstra and A* with a consistent bound; a key
+// below the last extracted one is treated as equal to it.
+class RadixHeap {
+public:
+    RadixHeap();
+
+    bool empty() const { return count == 0; }
+    const QueueEntry& top();
+    void push(const QueueEntry& entry);
+    void pop();
+    void clear();
+
+private:
+    static const int BucketCount = 65;
+
+    static quint64 bitsOf(double key);
+    int bucketFor(quint64 bits) const;
+
+    std::vector<QueueEntry> buckets[BucketCount];
+    quint64 last;
+    int count;
+};
+
+#endif // HEAPS_H
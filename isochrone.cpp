@@ -0,0 +1,178 @@
+#include "isochrone.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+struct Point {
+    double x;
+    double y;
+};
+
+double cross(const Point& o, const Point& a, const Point& b)
+{
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+double length(const Point& a, const Point& b)
+{
+    return std::hypot(b.x - a.x, b.y - a.y);
+}
+
+double segmentDistance(const Point& p, const Point& a, const Point& b)
+{
+    const double dx = b.x - a.x;
+    const double dy = b.y - a.y;
+    const double squared = dx * dx + dy * dy;
+    double t = squared > 0.0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / squared : 0.0;
+    t = std::max(0.0, std::min(1.0, t));
+    return std::hypot(p.x - (a.x + t * dx), p.y - (a.y + t * dy));
+}
+
+bool properlyIntersect(const Point& a, const Point& b, const Point& c, const Point& d)
+{
+    const double d1 = cross(a, b, c);
+    const double d2 = cross(a, b, d);
+    const double d3 = cross(c, d, a);
+    const double d4 = cross(c, d, b);
+    return ((d1 > 0.0 && d2 < 0.0) || (d1 < 0.0 && d2 > 0.0)) &&
+           ((d3 > 0.0 && d4 < 0.0) || (d3 < 0.0 && d4 > 0.0));
+}
+
+bool inTriangle(const Point& p, const Point& a, const Point& b, const Point& c)
+{
+    return cross(a, b, p) >= 0.0 && cross(b, c, p) >= 0.0 && cross(c, a, p) >= 0.0;
+}
+
+// Indices of the counter-clockwise convex hull (Andrew's monotone chain)
+std::vector<int> convexHull(const std::vector<Point>& points)
+{
+    std::vector<int> order(points.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<int>(i);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return points[a].x < points[b].x || (points[a].x == points[b].x && points[a].y < points[b].y);
+    });
+    if (order.size() < 3) {
+        return order;
+    }
+
+    std::vector<int> hull(order.size() * 2);
+    int k = 0;
+    for (int i : order) {
+        while (k >= 2 && cross(points[hull[k - 2]], points[hull[k - 1]], points[i]) <= 0.0) k--;
+        hull[k++] = i;
+    }
+    for (int j = static_cast<int>(order.size()) - 2, lower = k + 1; j >= 0; j--) {
+        const int i = order[j];
+        while (k >= lower && cross(points[hull[k - 2]], points[hull[k - 1]], points[i]) <= 0.0) k--;
+        hull[k++] = i;
+    }
+    hull.resize(k - 1);
+    return hull;
+}
+
+} // namespace
+
+std::vector<GeoCoord> concaveHull(const std::vector<GeoCoord>& coords, double concavity,
+                                  double minEdgeLength)
+{
+    if (coords.empty()) {
+        return {};
+    }
+
+    // Work in local meters around the first point
+    const double lat0 = coords.front().lat;
+    const double lon0 = coords.front().lon;
+    const double metersPerLat = 110540.0;
+    const double metersPerLon = 111320.0 * std::cos(lat0 * M_PI / 180.0);
+
+    // Drop points closer together than a fraction of the shortest edge worth
+    // digging; they cannot change the outline much but cost time
+    const double cell = minEdgeLength > 0.0 ? minEdgeLength / 4.0 : 1.0;
+    std::vector<std::pair<std::pair<long long, long long>, int>> cells;
+    for (size_t i = 0; i < coords.size(); i++) {
+        const double x = (coords[i].lon - lon0) * metersPerLon;
+        const double y = (coords[i].lat - lat0) * metersPerLat;
+        cells.push_back({{static_cast<long long>(std::floor(x / cell)),
+                          static_cast<long long>(std::floor(y / cell))},
+                         static_cast<int>(i)});
+    }
+    std::sort(cells.begin(), cells.end());
+
+    std::vector<Point> points;
+    std::vector<GeoCoord> kept;
+    for (size_t i = 0; i < cells.size(); i++) {
+        if (i > 0 && cells[i].first == cells[i - 1].first) {
+            continue;
+        }
+        const GeoCoord& c = coords[cells[i].second];
+        points.push_back({(c.lon - lon0) * metersPerLon, (c.lat - lat0) * metersPerLat});
+        kept.push_back(c);
+    }
+
+    std::vector<int> hull = convexHull(points);
+    std::vector<char> onHull(points.size(), 0);
+    for (int i : hull) {
+        onHull[i] = 1;
+    }
+
+    for (size_t i = 0; hull.size() >= 3 && i < hull.size(); ) {
+        const Point& a = points[hull[i]];
+        const Point& b = points[hull[(i + 1) % hull.size()]];
+        const double edgeLength = length(a, b);
+
+        // The inner point closest to this edge, on its inner side
+        int best = -1;
+        double bestDistance = 0.0;
+        if (edgeLength > minEdgeLength) {
+            for (size_t p = 0; p < points.size(); p++) {
+                if (onHull[p] || cross(a, b, points[p]) <= 0.0) {
+                    continue;
+                }
+                const double d = segmentDistance(points[p], a, b);
+                if (best < 0 || d < bestDistance) {
+                    best = static_cast<int>(p);
+                    bestDistance = d;
+                }
+            }
+        }
+
+        bool dig = false;
+        if (best >= 0) {
+            const Point& p = points[best];
+            const double nearEnd = std::min(length(a, p), length(p, b));
+            dig = nearEnd > 0.0 && edgeLength / nearEnd > concavity;
+
+            // Cutting the triangle away must keep every point inside and
+            // the outline simple
+            for (size_t q = 0; dig && q < points.size(); q++) {
+                if (static_cast<int>(q) != best && !onHull[q] && inTriangle(points[q], a, b, p)) {
+                    dig = false;
+                }
+            }
+            for (size_t e = 0; dig && e < hull.size(); e++) {
+                const Point& c = points[hull[e]];
+                const Point& d = points[hull[(e + 1) % hull.size()]];
+                if (properlyIntersect(a, p, c, d) || properlyIntersect(p, b, c, d)) {
+                    dig = false;
+                }
+            }
+        }
+
+        if (dig) {
+            // Stay on the new edge a -> p; it may need digging as well
+            hull.insert(hull.begin() + i + 1, best);
+            onHull[best] = 1;
+        } else {
+            i++;
+        }
+    }
+
+    std::vector<GeoCoord> outline;
+    for (int i : hull) {
+        outline.push_back(kept[i]);
+    }
+    return outline;
+}
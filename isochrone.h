@@ -0,0 +1,31 @@
+#ifndef ISOCHRONE_H
+#define ISOCHRONE_H
+
+#include <vector>
+#include "datatypes.h"
+
+// An edge whose start is reachable within the budget but whose end is not
+// along it. The covered part runs from the start of the edge to cutPoint.
+struct PartialEdge {
+    int edge;
+    int fromNode;
+    double fraction;    // Covered share of the edge, in [0, 1)
+    GeoCoord cutPoint;
+};
+
+// Everything reachable from one origin within a travel time budget
+struct Isochrone {
+    double budget;                          // Seconds
+    std::vector<int> nodes;                 // In order of travel time
+    std::vector<PartialEdge> partialEdges;
+    std::vector<GeoCoord> polygon;          // Outline, not closed explicitly
+};
+
+// Concave outline of a point set. Starts from the convex hull and keeps
+// digging edges inwards (Park and Oh's gift opening) while an edge is more
+// than `concavity` times longer than the distance from its nearer end to
+// the closest inner point, and longer than minEdgeLength meters.
+std::vector<GeoCoord> concaveHull(const std::vector<GeoCoord>& points, double concavity = 2.0,
+                                  double minEdgeLength = 0.0);
+
+#endif // ISOCHRONE_H
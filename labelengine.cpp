@@ -0,0 +1,172 @@
+#include "labelengine.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include "roadlayer.h"
+
+namespace {
+
+// Side of the collision grid's cells in pixels, about a short label
+const double CellSize = 64.0;
+
+// Padding around the text inside a label's frame
+const double PadX = 6.0;
+const double PadY = 2.0;
+
+qint64 cellKey(int column, int row)
+{
+    return (static_cast<qint64>(column) << 32) ^ static_cast<quint32>(row);
+}
+
+} // namespace
+
+LabelEngine::LabelEngine()
+    : font("Arial", 9, QFont::Bold)
+{
+}
+
+LabelEngine::LabelEngine(const GraphSnapshot& snapshot)
+    : LabelEngine()
+{
+    const RoadGraph& graph = snapshot.graph();
+    const ReverseIndex& reverse = graph.reverse();
+
+    struct Rank {
+        int bestClass;
+        int roads;
+        int node;
+    };
+    std::vector<Rank> ranks;
+    for (int u = 0; u < graph.nodeCount(); u++) {
+        if (!graph.hasName(u) || graph.nodeName(u).contains("Junction")) {
+            continue;
+        }
+
+        Rank rank = {static_cast<int>(RoadClass::Service) + 1, 0, u};
+        for (int e = graph.edgeBegin(u); e < graph.edgeEnd(u); e++) {
+            rank.bestClass = std::min(rank.bestClass, static_cast<int>(graph.edgeClass(e)));
+            rank.roads++;
+        }
+        for (int i = reverse.firstEdge[u]; i < reverse.firstEdge[u + 1]; i++) {
+            rank.bestClass = std::min(rank.bestClass, static_cast<int>(graph.edgeClass(reverse.edgeIds[i])));
+            rank.roads++;
+        }
+        ranks.push_back(rank);
+    }
+    std::sort(ranks.begin(), ranks.end(), [](const Rank& a, const Rank& b) {
+        if (a.bestClass != b.bestClass) {
+            return a.bestClass < b.bestClass;
+        }
+        if (a.roads != b.roads) {
+            return a.roads > b.roads;
+        }
+        return a.node < b.node;
+    });
+
+    labelOf.assign(graph.nodeCount(), -1);
+    labels.reserve(ranks.size());
+    for (const Rank& rank : ranks) {
+        Label label;
+        label.node = rank.node;
+        label.world = RoadLayer::toWorld(graph.coord(rank.node));
+        label.text.setText(graph.nodeName(rank.node));
+        label.text.setTextFormat(Qt::PlainText);
+        label.text.prepare(QTransform(), font);
+        label.box = label.text.size() + QSizeF(2 * PadX, 2 * PadY);
+
+        labelOf[rank.node] = static_cast<int>(labels.size());
+        labels.push_back(std::move(label));
+    }
+}
+
+std::vector<LabelEngine::Placement> LabelEngine::place(const std::vector<int>& nodes,
+                                                       const QTransform& toScreen) const
+{
+    std::vector<int> candidates;
+    for (int u : nodes) {
+        if (u < static_cast<int>(labelOf.size()) && labelOf[u] >= 0) {
+            candidates.push_back(labelOf[u]);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    std::vector<Placement> placed;
+    std::unordered_map<qint64, std::vector<int>> grid;     // Cell -> placed labels
+    auto cellsOf = [](const QRectF& box, auto visit) {
+        const int firstColumn = static_cast<int>(std::floor(box.left() / CellSize));
+        const int lastColumn = static_cast<int>(std::floor(box.right() / CellSize));
+        const int firstRow = static_cast<int>(std::floor(box.top() / CellSize));
+        const int lastRow = static_cast<int>(std::floor(box.bottom() / CellSize));
+        for (int row = firstRow; row <= lastRow; row++) {
+            for (int column = firstColumn; column <= lastColumn; column++) {
+                if (!visit(cellKey(column, row))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    for (int index : candidates) {
+        const Label& label = labels[index];
+        const QPointF at = toScreen.map(label.world);
+        const double w = label.box.width();
+        const double h = label.box.height();
+
+        // Below the marker, above it, then to its right and left
+        const QRectF spots[] = {
+            QRectF(at.x() - w / 2, at.y() + 18 - h / 2, w, h),
+            QRectF(at.x() - w / 2, at.y() - 24 - h / 2, w, h),
+            QRectF(at.x() + 10, at.y() - h / 2, w, h),
+            QRectF(at.x() - 10 - w, at.y() - h / 2, w, h)
+        };
+        for (const QRectF& box : spots) {
+            const bool free = cellsOf(box, [&](qint64 key) {
+                auto cell = grid.find(key);
+                if (cell == grid.end()) {
+                    return true;
+                }
+                for (int other : cell->second) {
+                    if (placed[other].box.intersects(box)) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+            if (free) {
+                const int id = static_cast<int>(placed.size());
+                placed.push_back({index, box});
+                cellsOf(box, [&](qint64 key) {
+                    grid[key].push_back(id);
+                    return true;
+                });
+                break;
+            }
+        }
+    }
+    return placed;
+}
+
+void LabelEngine::paint(QPainter& painter, const std::vector<Placement>& placements) const
+{
+    QMutexLocker locker(&paintLock);
+    painter.save();
+    painter.setFont(font);
+
+    for (const Placement& placement : placements) {
+        const QRectF& box = placement.box;
+
+        painter.setBrush(QColor(0, 0, 0, 70));
+        painter.setPen(Qt::NoPen);
+        painter.drawRoundedRect(box.adjusted(1, 1, 1, 1), 3, 3);
+
+        painter.setBrush(QColor(44, 62, 80, 250));
+        painter.setPen(QPen(QColor(52, 73, 94), 1));
+        painter.drawRoundedRect(box, 3, 3);
+
+        painter.setPen(Qt::white);
+        painter.drawStaticText(box.topLeft() + QPointF(PadX, PadY), labels[placement.label].text);
+    }
+    painter.restore();
+}
@@ -0,0 +1,59 @@
+#ifndef LABELENGINE_H
+#define LABELENGINE_H
+
+#include <QFont>
+#include <QMutex>
+#include <QPainter>
+#include <QRectF>
+#include <QStaticText>
+#include <QTransform>
+#include <vector>
+#include "graphsnapshot.h"
+
+// Place-name labels, shaped once per graph snapshot and placed without
+// overlaps.
+//
+// Every named place (a named node that is not a "Junction") gets its text
+// laid out in a QStaticText up front, so a frame neither builds fonts nor
+// measures strings. Placement tries a few spots around each place, most
+// important place first, and keeps the first spot whose box does not hit
+// one already placed; boxes are found through a screen-space grid.
+//
+// Importance comes from the roads at the place: the best road class
+// first, then the number of roads.
+class LabelEngine {
+public:
+    struct Placement {
+        int label;
+        QRectF box;     // Screen rectangle of the label, frame included
+    };
+
+    LabelEngine();
+    explicit LabelEngine(const GraphSnapshot& snapshot);
+
+    bool isEmpty() const { return labels.empty(); }
+
+    // Places the labels of those nodes that are places, with world
+    // coordinates (see RoadLayer::toWorld) mapped to the screen by toScreen
+    std::vector<Placement> place(const std::vector<int>& nodes, const QTransform& toScreen) const;
+    // Draws placed labels. The painter must not be transformed. Safe to call
+    // from several threads at once.
+    void paint(QPainter& painter, const std::vector<Placement>& placements) const;
+
+private:
+    struct Label {
+        int node;
+        QPointF world;
+        QStaticText text;
+        QSizeF box;
+    };
+
+    QFont font;
+    std::vector<Label> labels;          // Most important first
+    std::vector<int> labelOf;           // Per node, -1 for none
+
+    // Drawing may lay the texts out again, which QStaticText does in place
+    mutable QMutex paintLock;
+};
+
+#endif // LABELENGINE_H
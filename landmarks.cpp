@@ -0,0 +1,350 @@
+#include "landmarks.h"
+#include <QtConcurrent>
+#include <queue>
+#include <random>
+#include <numeric>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const double Infinity = std::numeric_limits<double>::infinity();
+
+// Tables are stored as floats; shrinking each bound by this fraction of the
+// operands keeps it admissible despite the rounding of both values.
+const double RoundingSlack = 1e-6;
+
+// One-to-all Dijkstra from source, over reversed edges when backward is set.
+// Optionally records the shortest path tree and the settle order. Returns
+// false when stopped through control.
+bool shortestPaths(const RoadGraph& graph, const ReverseIndex& reverse, RouteMetric metric,
+                   int source, bool backward, std::vector<double>& dist, QueryControl* control,
+                   std::vector<int>* parent = nullptr, std::vector<int>* order = nullptr)
+{
+    using Entry = std::pair<double, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> pq;
+
+    dist.assign(graph.nodeCount(), Infinity);
+    if (parent) parent->assign(graph.nodeCount(), -1);
+    if (order) order->clear();
+
+    dist[source] = 0.0;
+    pq.push({0.0, source});
+    int settled = 0;
+
+    while (!pq.empty()) {
+        Entry current = pq.top();
+        pq.pop();
+
+        const int u = current.second;
+        if (current.first > dist[u]) {
+            continue;
+        }
+        if (order) order->push_back(u);
+
+        // Several searches share one control, so progress accumulates
+        if (control && (++settled & 255) == 0) {
+            control->settledNodes.fetch_add(256, std::memory_order_relaxed);
+            if (control->cancelled.load(std::memory_order_relaxed)) {
+                return false;
+            }
+        }
+
+        const int begin = backward ? reverse.firstEdge[u] : graph.edgeBegin(u);
+        const int end = backward ? reverse.firstEdge[u + 1] : graph.edgeEnd(u);
+        for (int i = begin; i < end; i++) {
+            int next = backward ? reverse.sources[i] : graph.edgeTarget(i);
+            int edge = backward ? reverse.edgeIds[i] : i;
+            double newCost = current.first + graph.edgeCost(edge, metric);
+
+            if (newCost < dist[next]) {
+                dist[next] = newCost;
+                if (parent) (*parent)[next] = u;
+                pq.push({newCost, next});
+            }
+        }
+    }
+    return true;
+}
+
+// Lower bound a - b from two table entries
+double boundFrom(float a, float b)
+{
+    if (std::isinf(a) || std::isinf(b)) {
+        // Only "a unreachable, b reachable" proves anything: no path at all
+        return std::isinf(a) && !std::isinf(b) ? Infinity : 0.0;
+    }
+    return (static_cast<double>(a) - b) - RoundingSlack * (static_cast<double>(a) + b);
+}
+
+int farthestNode(const std::vector<double>& dist, const std::vector<int>& exclude)
+{
+    int best = -1;
+    for (int v = 0; v < static_cast<int>(dist.size()); v++) {
+        if (std::isinf(dist[v]) ||
+            std::find(exclude.begin(), exclude.end(), v) != exclude.end()) {
+            continue;
+        }
+        if (best < 0 || dist[v] > dist[best]) {
+            best = v;
+        }
+    }
+    return best;
+}
+
+// Both selections return nothing when cancelled
+std::vector<int> selectFarthest(const RoadGraph& graph, const ReverseIndex& reverse,
+                                RouteMetric metric, int count, QueryControl* control)
+{
+    std::vector<int> chosen;
+    std::vector<double> dist;
+
+    // Start from the node farthest away from an arbitrary one
+    if (!shortestPaths(graph, reverse, metric, 0, false, dist, control)) {
+        return std::vector<int>();
+    }
+    int first = farthestNode(dist, chosen);
+    if (first < 0) {
+        return chosen;
+    }
+    chosen.push_back(first);
+
+    std::vector<double> nearest;
+    if (!shortestPaths(graph, reverse, metric, first, false, nearest, control)) {
+        return std::vector<int>();
+    }
+
+    while (static_cast<int>(chosen.size()) < count) {
+        int next = farthestNode(nearest, chosen);
+        if (next < 0) {
+            break;
+        }
+        chosen.push_back(next);
+
+        if (!shortestPaths(graph, reverse, metric, next, false, dist, control)) {
+            return std::vector<int>();
+        }
+        for (size_t v = 0; v < nearest.size(); v++) {
+            nearest[v] = std::min(nearest[v], dist[v]);
+        }
+    }
+    return chosen;
+}
+
+std::vector<int> selectAvoid(const RoadGraph& graph, const ReverseIndex& reverse,
+                             RouteMetric metric, int count, QueryControl* control)
+{
+    const int nodeCount = graph.nodeCount();
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> anyNode(0, nodeCount - 1);
+
+    std::vector<int> chosen;
+    std::vector<std::vector<double>> chosenDist;    // d(L, v) per chosen landmark
+    std::vector<double> dist;
+    std::vector<int> parent;
+    std::vector<int> order;
+
+    int attempts = 0;
+    while (static_cast<int>(chosen.size()) < count && attempts++ < count * 4) {
+        const int root = anyNode(rng);
+        if (!shortestPaths(graph, reverse, metric, root, false, dist, control, &parent, &order)) {
+            return std::vector<int>();
+        }
+
+        // Weight of a node is how much the current landmarks underestimate
+        // its distance from the root; the size of a subtree sums those
+        // weights, or is zero once the subtree already holds a landmark.
+        std::vector<double> size(nodeCount, 0.0);
+        std::vector<char> hasLandmark(nodeCount, 0);
+        for (int landmark : chosen) {
+            hasLandmark[landmark] = 1;
+        }
+
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            const int v = *it;
+            double bound = 0.0;
+            for (const auto& fromL : chosenDist) {
+                if (!std::isinf(fromL[v]) && !std::isinf(fromL[root])) {
+                    bound = std::max(bound, fromL[v] - fromL[root]);
+                }
+            }
+            size[v] += dist[v] - bound;
+            if (hasLandmark[v]) {
+                size[v] = 0.0;
+            }
+
+            if (parent[v] >= 0) {
+                if (hasLandmark[v]) {
+                    hasLandmark[parent[v]] = 1;
+                }
+                size[parent[v]] += size[v];
+            }
+        }
+
+        // Walk down from the root into the heaviest subtree until a leaf
+        std::vector<std::vector<int>> children(nodeCount);
+        for (int v : order) {
+            if (parent[v] >= 0) {
+                children[parent[v]].push_back(v);
+            }
+        }
+
+        int node = root;
+        while (!children[node].empty()) {
+            int heaviest = children[node].front();
+            for (int child : children[node]) {
+                if (size[child] > size[heaviest]) {
+                    heaviest = child;
+                }
+            }
+            if (size[heaviest] <= 0.0) {
+                break;
+            }
+            node = heaviest;
+        }
+
+        if (std::find(chosen.begin(), chosen.end(), node) != chosen.end() ||
+            size[node] <= 0.0) {
+            continue;
+        }
+
+        chosen.push_back(node);
+        chosenDist.emplace_back();
+        if (!shortestPaths(graph, reverse, metric, node, false, chosenDist.back(), control)) {
+            return std::vector<int>();
+        }
+    }
+    return chosen;
+}
+
+} // namespace
+
+LandmarkIndex::LandmarkIndex()
+    : indexMetric(RouteMetric::Distance),
+    nodesFingerprint(0)
+{
+}
+
+quint64 LandmarkIndex::fingerprint(const RoadGraph& graph)
+{
+    // FNV-1a over the node count and every node's position
+    quint64 hash = 14695981039346656037ULL;
+    auto mix = [&hash](quint64 value) {
+        for (int i = 0; i < 8; i++) {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    mix(static_cast<quint64>(graph.nodeCount()));
+    for (int u = 0; u < graph.nodeCount(); u++) {
+        const GeoCoord coord = graph.coord(u);
+        quint64 bits[2];
+        std::memcpy(&bits[0], &coord.lat, sizeof(bits[0]));
+        std::memcpy(&bits[1], &coord.lon, sizeof(bits[1]));
+        mix(bits[0]);
+        mix(bits[1]);
+    }
+    return hash;
+}
+
+void LandmarkIndex::clear()
+{
+    landmarks.clear();
+    fromLandmark.clear();
+    toLandmark.clear();
+}
+
+bool LandmarkIndex::build(const RoadGraph& graph, const ReverseIndex& reverse, RouteMetric metric,
+                          int landmarkCount, LandmarkSelection selection, QueryControl* control)
+{
+    clear();
+    indexMetric = metric;
+    nodesFingerprint = fingerprint(graph);
+
+    if (graph.nodeCount() == 0 || landmarkCount <= 0) {
+        return true;
+    }
+
+    landmarkCount = std::min(landmarkCount, graph.nodeCount());
+    landmarks = selection == LandmarkSelection::Farthest
+                    ? selectFarthest(graph, reverse, metric, landmarkCount, control)
+                    : selectAvoid(graph, reverse, metric, landmarkCount, control);
+
+    return refresh(graph, reverse, control);
+}
+
+bool LandmarkIndex::refresh(const RoadGraph& graph, const ReverseIndex& reverse, QueryControl* control)
+{
+    const size_t count = landmarks.size();
+    const size_t nodeCount = graph.nodeCount();
+    fromLandmark.assign(nodeCount * count, std::numeric_limits<float>::infinity());
+    toLandmark.assign(nodeCount * count, std::numeric_limits<float>::infinity());
+
+    // Task 2i fills the column "from landmark i", 2i + 1 "to landmark i"
+    std::vector<int> tasks(count * 2);
+    std::iota(tasks.begin(), tasks.end(), 0);
+
+    QtConcurrent::blockingMap(tasks, [&](int task) {
+        const size_t i = task / 2;
+        const bool backward = (task % 2) == 1;
+        std::vector<float>& table = backward ? toLandmark : fromLandmark;
+
+        std::vector<double> dist;
+        if (!shortestPaths(graph, reverse, indexMetric, landmarks[i], backward, dist, control)) {
+            return;
+        }
+        for (size_t v = 0; v < nodeCount; v++) {
+            table[v * count + i] = static_cast<float>(dist[v]);
+        }
+    });
+
+    if (control && control->cancelled.load()) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+std::vector<int> LandmarkIndex::selectActive(int startNodeId, int endNodeId, int maxCount) const
+{
+    const size_t count = landmarks.size();
+    std::vector<std::pair<double, int>> ranked;
+
+    for (size_t i = 0; i < count; i++) {
+        double bound = std::max(
+            boundFrom(fromLandmark[endNodeId * count + i], fromLandmark[startNodeId * count + i]),
+            boundFrom(toLandmark[startNodeId * count + i], toLandmark[endNodeId * count + i]));
+        ranked.push_back({bound, static_cast<int>(i)});
+    }
+
+    std::sort(ranked.begin(), ranked.end(), std::greater<std::pair<double, int>>());
+
+    std::vector<int> active;
+    for (size_t i = 0; i < ranked.size() && static_cast<int>(i) < maxCount; i++) {
+        active.push_back(ranked[i].second);
+    }
+    return active;
+}
+
+double LandmarkIndex::lowerBound(int nodeId, int endNodeId, const std::vector<int>& active) const
+{
+    const size_t count = landmarks.size();
+    if (active.empty()) {
+        return 0.0;
+    }
+
+    const float* node = &fromLandmark[nodeId * count];
+    const float* target = &fromLandmark[endNodeId * count];
+    const float* nodeTo = &toLandmark[nodeId * count];
+    const float* targetTo = &toLandmark[endNodeId * count];
+
+    double best = 0.0;
+    for (int i : active) {
+        best = std::max(best, boundFrom(target[i], node[i]));
+        best = std::max(best, boundFrom(nodeTo[i], targetTo[i]));
+    }
+    return best;
+}
@@ -0,0 +1,58 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <vector>
+#include "datatypes.h"
+#include "roadgraph.h"
+
+// How LandmarkIndex::build picks its landmarks
+enum class LandmarkSelection {
+    Farthest,   // Repeatedly take the node farthest from the chosen set
+    Avoid       // Goldberg-Werneck "avoid": grow into poorly covered regions
+};
+
+// Landmark distance tables for ALT (A*, landmarks, triangle inequality).
+//
+// For every landmark L the index stores d(L, v) and d(v, L) for all nodes.
+// Since d(L, t) <= d(L, v) + d(v, t) and d(v, L) <= d(v, t) + d(t, L),
+// both d(L, t) - d(L, v) and d(v, L) - d(t, L) are lower bounds on d(v, t)
+// for any metric. Tables are node-major floats, so the K values a query
+// reads for one node sit next to each other.
+class LandmarkIndex {
+public:
+    LandmarkIndex();
+
+    // Both add the nodes their searches settle to control's progress, and
+    // stop once it is cancelled, returning false with the index left empty
+    bool build(const RoadGraph& graph, const ReverseIndex& reverse, RouteMetric metric,
+               int landmarkCount, LandmarkSelection selection = LandmarkSelection::Avoid,
+               QueryControl* control = nullptr);
+    // Recomputes the tables for the same landmarks after edge weights change.
+    // Only meaningful for a graph with the same nodes, see sameNodes().
+    bool refresh(const RoadGraph& graph, const ReverseIndex& reverse, QueryControl* control = nullptr);
+    void clear();
+
+    bool isEmpty() const { return landmarks.empty(); }
+    RouteMetric metric() const { return indexMetric; }
+    const std::vector<int>& landmarkNodes() const { return landmarks; }
+    // Whether graph has the nodes, ids and positions alike, of the graph
+    // the landmarks were chosen for
+    bool sameNodes(const RoadGraph& graph) const { return nodesFingerprint == fingerprint(graph); }
+
+    static quint64 fingerprint(const RoadGraph& graph);
+
+    // The landmarks giving the tightest bound for this query, at most maxCount
+    std::vector<int> selectActive(int startNodeId, int endNodeId, int maxCount) const;
+    double lowerBound(int nodeId, int endNodeId, const std::vector<int>& active) const;
+
+private:
+    RouteMetric indexMetric;
+    quint64 nodesFingerprint;
+    std::vector<int> landmarks;
+
+    // [node * landmarks.size() + i], infinity where unreachable
+    std::vector<float> fromLandmark;
+    std::vector<float> toLandmark;
+};
+
+#endif // LANDMARKS_H
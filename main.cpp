@@ -1,12 +1,100 @@
 #include "mainwindow.h"
 #include <QApplication>
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include "bench.h"
+#include "tilemanager.h"
+
+namespace {
+
+// DS_map_pro --generate-tiles <map> [first-zoom last-zoom] [pixel-ratio]
+//
+// Renders the road tiles of a map into the tile pack the application reads
+// them from at that pixel ratio, on all cores and without a window. Tiles
+// already in the pack are skipped, so an interrupted run picks up where it
+// stopped.
+int generateTiles(const QStringList& args)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (args.size() != 3 && args.size() != 5 && args.size() != 6) {
+        err << "Usage: " << args.at(0) << " --generate-tiles <map> [first-zoom last-zoom] [pixel-ratio]\n";
+        return 2;
+    }
+
+    // By default the zooms the map view draws, from 0.05 to 30 pixels per unit
+    int firstZoom = TileManager::zoomForScale(0.05);
+    int lastZoom = TileManager::zoomForScale(30.0);
+    qreal ratio = 1.0;
+    if (args.size() >= 5) {
+        firstZoom = args.at(3).toInt();
+        lastZoom = args.at(4).toInt();
+    }
+    if (args.size() == 6) {
+        ratio = args.at(5).toDouble();
+    }
+    if (firstZoom > lastZoom || ratio <= 0.0) {
+        err << "Invalid zoom range or pixel ratio\n";
+        return 2;
+    }
+
+    MainWindow::MapImport map = MainWindow::importMap(args.at(2));
+    if (!map.snapshot) {
+        err << "Could not load " << args.at(2) << ": " << map.error << "\n";
+        return 1;
+    }
+
+    TilePack pack;
+    const QString packPath = TilePack::pathFor(map.tilePack, ratio);
+    if (!pack.open(packPath, ratio)) {
+        err << "Could not open " << packPath << "\n";
+        return 1;
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+    for (int zoom = firstZoom; zoom <= lastZoom; zoom++) {
+        const int rendered = TileManager::generate(*map.layers.roads, pack, zoom, zoom);
+        out << "Zoom " << zoom << ": " << rendered << " tiles rendered\n";
+        out.flush();
+    }
+    out << pack.tileCount() << " tiles in " << packPath
+        << " (" << clock.elapsed() / 1000.0 << " s)\n";
+    return 0;
+}
+
+} // namespace
 
 int main(int argc, char *argv[])
 {
+    // Tiles are drawn on images only, so no display is needed
+    if (argc > 1 && QString(argv[1]) == "--generate-tiles") {
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        QGuiApplication app(argc, argv);
+        return generateTiles(app.arguments());
+    }
+    // So are the benchmarks that paint
+    if (argc > 1 && QString(argv[1]) == "--bench") {
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        QGuiApplication app(argc, argv);
+        return runBenchmarks(app.arguments());
+    }
+
     QApplication app(argc, argv);
 
     MainWindow window;
     window.show();
 
+    // An OpenStreetMap extract given on the command line replaces the sample city
+    const QStringList args = app.arguments();
+    if (args.size() > 1) {
+        window.openMap(args.at(1));
+    }
+
     return app.exec();
 }
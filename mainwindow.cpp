@@ -8,6 +8,15 @@
 #include <QLineEdit>
 #include <QListWidget>
 #include <QLabel>
+#include <QComboBox>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QtConcurrent>
+#include "osmimporter.h"
+#include <algorithm>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
@@ -19,12 +28,18 @@ MainWindow::MainWindow(QWidget *parent)
     btnSetStart(nullptr),
     btnSetEnd(nullptr),
     btnFindRoute(nullptr),
+    routingModeBox(nullptr),
+    btnReachable(nullptr),
+    btnOpenMap(nullptr),
     btnZoomIn(nullptr),
     btnZoomOut(nullptr),
     btnResetView(nullptr),
     statusLabel(nullptr),
-    startNodeId(-1),
-    endNodeId(-1)
+    pendingRequestId(0),
+    progressTimer(nullptr),
+    importWatcher(nullptr),
+    reachWatcher(nullptr),
+    reachOrigin(-1)
 {
     setWindowTitle("Map Navigator - Qt Project");
     resize(1200, 800);
@@ -33,6 +48,19 @@ MainWindow::MainWindow(QWidget *parent)
 
     searchEngine = new SearchEngine(this);
     router = new Router(this);
+    connect(router, &Router::routeFinished, this, &MainWindow::onRouteFinished);
+    connect(router, &Router::prepareFinished, this, &MainWindow::onPrepareFinished);
+
+    progressTimer = new QTimer(this);
+    progressTimer->setInterval(100);
+    connect(progressTimer, &QTimer::timeout, this, &MainWindow::onRouteProgress);
+
+    importWatcher = new QFutureWatcher<MapImport>(this);
+    connect(importWatcher, &QFutureWatcher<MapImport>::finished, this, &MainWindow::onMapImported);
+
+    reachWatcher = new QFutureWatcher<std::vector<Isochrone>>(this);
+    connect(reachWatcher, &QFutureWatcher<std::vector<Isochrone>>::finished, this,
+            &MainWindow::onReachableFinished);
 
     loadSampleData();
 }
@@ -64,14 +92,30 @@ void MainWindow::setupUI()
     btnSetStart = new QPushButton("📍 Set Start", this);
     btnSetEnd = new QPushButton("🎯 Set End", this);
     btnFindRoute = new QPushButton("🚗 Find Route", this);
+    btnReachable = new QPushButton("⏱ Reachable", this);
+    btnOpenMap = new QPushButton("📂 Open Map", this);
 
     btnSetStart->setObjectName("btnStart");
     btnSetEnd->setObjectName("btnEnd");
     btnFindRoute->setObjectName("btnRoute");
+    btnReachable->setObjectName("btnReachable");
+    btnOpenMap->setObjectName("btnOpenMap");
+
+    routingModeBox = new QComboBox(this);
+    routingModeBox->setObjectName("routingMode");
+    routingModeBox->addItem("Dijkstra (shortest)");
+    routingModeBox->addItem("A* (shortest)");
+    routingModeBox->addItem("A* (fastest)");
+    routingModeBox->addItem("Bidirectional (shortest)");
+    routingModeBox->addItem("Contraction hierarchy (fastest)");
+    routingModeBox->addItem("ALT landmarks (fastest)");
 
     searchLayout->addWidget(btnSetStart);
     searchLayout->addWidget(btnSetEnd);
+    searchLayout->addWidget(routingModeBox);
     searchLayout->addWidget(btnFindRoute);
+    searchLayout->addWidget(btnReachable);
+    searchLayout->addWidget(btnOpenMap);
 
     mainLayout->addWidget(toolbar);
 
@@ -129,9 +173,14 @@ void MainWindow::setupUI()
     // Connect signals
     connect(searchBox, &QLineEdit::textChanged, this, &MainWindow::onSearchTextChanged);
     connect(searchResults, &QListWidget::itemClicked, this, &MainWindow::onSearchResultSelected);
+    connect(mapView, &MapView::nodeClicked, this, &MainWindow::onNodeClicked);
+    connect(mapView, &MapView::roadClicked, this, &MainWindow::onRoadClicked);
     connect(btnSetStart, &QPushButton::clicked, this, &MainWindow::onSetStartClicked);
     connect(btnSetEnd, &QPushButton::clicked, this, &MainWindow::onSetEndClicked);
     connect(btnFindRoute, &QPushButton::clicked, this, &MainWindow::onFindRouteClicked);
+    connect(btnReachable, &QPushButton::clicked, this, &MainWindow::onReachableClicked);
+    connect(btnOpenMap, &QPushButton::clicked, this, &MainWindow::onOpenMapClicked);
+    connect(routingModeBox, &QComboBox::currentIndexChanged, this, &MainWindow::onRoutingModeChanged);
     connect(btnZoomIn, &QPushButton::clicked, this, &MainWindow::onZoomInClicked);
     connect(btnZoomOut, &QPushButton::clicked, this, &MainWindow::onZoomOutClicked);
     connect(btnResetView, &QPushButton::clicked, this, &MainWindow::onResetViewClicked);
@@ -216,6 +265,42 @@ void MainWindow::applyStyles()
             background: #d68910;
         }
 
+        #btnReachable {
+            background: qlineargradient(x1:0, y1:0, x2:0, y2:1,
+                                       stop:0 #9b59b6, stop:1 #8e44ad);
+        }
+
+        #btnReachable:hover {
+            background: #9b59b6;
+        }
+
+        #btnReachable:pressed {
+            background: #7d3c98;
+        }
+
+        #btnOpenMap {
+            background: qlineargradient(x1:0, y1:0, x2:0, y2:1,
+                                       stop:0 #7f8c8d, stop:1 #707b7c);
+        }
+
+        #btnOpenMap:hover {
+            background: #7f8c8d;
+        }
+
+        #btnOpenMap:pressed {
+            background: #616a6b;
+        }
+
+        #routingMode {
+            padding: 8px 12px;
+            font-size: 13px;
+            border: 2px solid #bdc3c7;
+            border-radius: 5px;
+            background-color: white;
+            color: #2c3e50;
+            min-width: 150px;
+        }
+
         #zoomControls {
             background-color: rgba(255, 255, 255, 230);
             border-radius: 8px;
@@ -279,43 +364,42 @@ void MainWindow::applyStyles()
 
 void MainWindow::loadSampleData()
 {
-    std::vector<Node> nodes;
-    AdjacencyList graph;
+    RoadGraphBuilder builder;
 
     // Create a more realistic city layout with varied distances
     double baseLat = 28.6139;
     double baseLon = 77.2090;
 
-    // Create nodes at realistic positions (not uniform grid)
-    nodes.push_back(Node(0, baseLat + 0.040, baseLon + 0.005, "Central Park"));
-    nodes.push_back(Node(1, baseLat + 0.038, baseLon + 0.015, ""));
-    nodes.push_back(Node(2, baseLat + 0.035, baseLon + 0.025, ""));
-    nodes.push_back(Node(3, baseLat + 0.040, baseLon + 0.032, ""));
-    nodes.push_back(Node(4, baseLat + 0.042, baseLon + 0.045, "Airport"));
-
-    nodes.push_back(Node(5, baseLat + 0.028, baseLon + 0.008, ""));
-    nodes.push_back(Node(6, baseLat + 0.025, baseLon + 0.018, "City Hall"));
-    nodes.push_back(Node(7, baseLat + 0.025, baseLon + 0.028, ""));
-    nodes.push_back(Node(8, baseLat + 0.028, baseLon + 0.038, "Train Station"));
-    nodes.push_back(Node(9, baseLat + 0.030, baseLon + 0.048, ""));
-
-    nodes.push_back(Node(10, baseLat + 0.015, baseLon + 0.005, ""));
-    nodes.push_back(Node(11, baseLat + 0.012, baseLon + 0.015, ""));
-    nodes.push_back(Node(12, baseLat + 0.015, baseLon + 0.025, "Main Square"));
-    nodes.push_back(Node(13, baseLat + 0.018, baseLon + 0.035, ""));
-    nodes.push_back(Node(14, baseLat + 0.015, baseLon + 0.045, ""));
-
-    nodes.push_back(Node(15, baseLat + 0.005, baseLon + 0.008, ""));
-    nodes.push_back(Node(16, baseLat + 0.002, baseLon + 0.018, "Shopping Mall"));
-    nodes.push_back(Node(17, baseLat + 0.005, baseLon + 0.028, ""));
-    nodes.push_back(Node(18, baseLat + 0.008, baseLon + 0.038, ""));
-    nodes.push_back(Node(19, baseLat + 0.005, baseLon + 0.048, ""));
-
-    nodes.push_back(Node(20, baseLat - 0.005, baseLon + 0.005, "University"));
-    nodes.push_back(Node(21, baseLat - 0.008, baseLon + 0.015, ""));
-    nodes.push_back(Node(22, baseLat - 0.005, baseLon + 0.025, ""));
-    nodes.push_back(Node(23, baseLat - 0.002, baseLon + 0.035, "Hospital"));
-    nodes.push_back(Node(24, baseLat - 0.005, baseLon + 0.045, "Stadium"));
+    // Create nodes at realistic positions (not uniform grid); external ids follow insertion order
+    builder.addNode(baseLat + 0.040, baseLon + 0.005, "Central Park");
+    builder.addNode(baseLat + 0.038, baseLon + 0.015, "");
+    builder.addNode(baseLat + 0.035, baseLon + 0.025, "");
+    builder.addNode(baseLat + 0.040, baseLon + 0.032, "");
+    builder.addNode(baseLat + 0.042, baseLon + 0.045, "Airport");
+
+    builder.addNode(baseLat + 0.028, baseLon + 0.008, "");
+    builder.addNode(baseLat + 0.025, baseLon + 0.018, "City Hall");
+    builder.addNode(baseLat + 0.025, baseLon + 0.028, "");
+    builder.addNode(baseLat + 0.028, baseLon + 0.038, "Train Station");
+    builder.addNode(baseLat + 0.030, baseLon + 0.048, "");
+
+    builder.addNode(baseLat + 0.015, baseLon + 0.005, "");
+    builder.addNode(baseLat + 0.012, baseLon + 0.015, "");
+    builder.addNode(baseLat + 0.015, baseLon + 0.025, "Main Square");
+    builder.addNode(baseLat + 0.018, baseLon + 0.035, "");
+    builder.addNode(baseLat + 0.015, baseLon + 0.045, "");
+
+    builder.addNode(baseLat + 0.005, baseLon + 0.008, "");
+    builder.addNode(baseLat + 0.002, baseLon + 0.018, "Shopping Mall");
+    builder.addNode(baseLat + 0.005, baseLon + 0.028, "");
+    builder.addNode(baseLat + 0.008, baseLon + 0.038, "");
+    builder.addNode(baseLat + 0.005, baseLon + 0.048, "");
+
+    builder.addNode(baseLat - 0.005, baseLon + 0.005, "University");
+    builder.addNode(baseLat - 0.008, baseLon + 0.015, "");
+    builder.addNode(baseLat - 0.005, baseLon + 0.025, "");
+    builder.addNode(baseLat - 0.002, baseLon + 0.035, "Hospital");
+    builder.addNode(baseLat - 0.005, baseLon + 0.045, "Stadium");
 
     // Create realistic road connections with varied distances
     // Main highways
@@ -323,10 +407,8 @@ void MainWindow::loadSampleData()
         for (int j = 0; j < 4; j++) {
             int nodeId = i * 5 + j;
             int rightId = i * 5 + (j + 1);
-            double dist = nodes[nodeId].coord.distanceTo(nodes[rightId].coord);
             double speed = (i == 2) ? 70.0 : 50.0; // Main square row is faster
-            graph[nodeId].push_back(Edge(rightId, dist, speed, "Main Road"));
-            graph[rightId].push_back(Edge(nodeId, dist, speed, "Main Road"));
+            builder.addRoad(nodeId, rightId, speed, "Main Road");
         }
     }
 
@@ -335,34 +417,153 @@ void MainWindow::loadSampleData()
         for (int j = 0; j < 5; j++) {
             int nodeId = i * 5 + j;
             int downId = (i + 1) * 5 + j;
-            double dist = nodes[nodeId].coord.distanceTo(nodes[downId].coord);
             double speed = (j == 2) ? 70.0 : 50.0; // Middle column is faster
-            graph[nodeId].push_back(Edge(downId, dist, speed, "Avenue"));
-            graph[downId].push_back(Edge(nodeId, dist, speed, "Avenue"));
+            builder.addRoad(nodeId, downId, speed, "Avenue");
         }
     }
 
     // Add some diagonal shortcuts (expressways)
-    graph[0].push_back(Edge(6, nodes[0].coord.distanceTo(nodes[6].coord), 80.0, "Express Way"));
-    graph[6].push_back(Edge(0, nodes[0].coord.distanceTo(nodes[6].coord), 80.0, "Express Way"));
+    builder.addRoad(0, 6, 80.0, "Express Way");
+    builder.addRoad(4, 8, 80.0, "Airport Express");
+    builder.addRoad(12, 18, 80.0, "Metro Line");
+    builder.addRoad(20, 24, 60.0, "Ring Road");
+
+    // One immutable copy of the network, shared by every component
+    GraphSnapshotPtr snapshot = GraphSnapshot::create(builder.build(NodeOrder::Hilbert));
+    const RoadGraph& graph = snapshot->graph();
+    // The sample city is small enough to prepare for drawing right here
+    showGraph(snapshot, MapView::buildLayers(snapshot), graph.coord(graph.internalId(12)));
+
+    statusLabel->setText(QString("Loaded %1 locations | Search or click on map")
+                             .arg(graph.nodeCount()));
+}
+
+void MainWindow::showGraph(const GraphSnapshotPtr& snapshot, const MapView::GraphLayers& layers,
+                           const GeoCoord& home, const QString& tilePack, const QString& hierarchy)
+{
+    // Node ids from the previous graph mean nothing in this one
+    router->cancelRoute();
+    pendingRequestId = 0;
+    routeStart = Waypoint();
+    routeEnd = Waypoint();
+    reachOrigin = -1;
+
+    searchEngine->setGraph(snapshot);
+    router->setGraph(snapshot);
+
+    mapView->setGraph(snapshot, layers);
+    mapView->setTilePack(tilePack);
+    hierarchyFile = hierarchy;
+    mapView->setRoute({});
+    mapView->setIsochrones({});
+    mapView->setHighlightNode(-1);
+
+    homeCoord = home;
+    mapView->centerOn(homeCoord);
+}
+
+void MainWindow::openMap(const QString& path)
+{
+    if (importWatcher->isRunning()) {
+        statusLabel->setText("Another map is still loading...");
+        return;
+    }
+
+    btnOpenMap->setEnabled(false);
+    statusLabel->setText(QString("Loading %1...").arg(QFileInfo(path).fileName()));
 
-    graph[4].push_back(Edge(8, nodes[4].coord.distanceTo(nodes[8].coord), 80.0, "Airport Express"));
-    graph[8].push_back(Edge(4, nodes[4].coord.distanceTo(nodes[8].coord), 80.0, "Airport Express"));
+    importWatcher->setFuture(QtConcurrent::run([path]() { return importMap(path); }));
+}
+
+MainWindow::MapImport MainWindow::importMap(const QString& path)
+{
+    // Imported extracts are cached as graph files, which later opens map in
+    // place instead of parsing the extract again. Rendered tiles and the
+    // contraction hierarchy are kept beside them.
+    QFileInfo info(path);
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/maps";
+    const QString cacheName = QString("%1/%2-%3-%4")
+                                  .arg(cacheDir, info.fileName())
+                                  .arg(info.size())
+                                  .arg(info.lastModified().toMSecsSinceEpoch());
+    const QString cacheFile = cacheName + ".rgraph";
+    const bool graphFile = path.endsWith(".rgraph", Qt::CaseInsensitive);
+    QDir().mkpath(cacheDir);
+
+    MapImport result;
+    result.path = path;
+    result.tilePack = cacheName + ".tiles";
+    result.hierarchy = cacheName + "-time.ch";
+
+    RoadGraph graph;
+    if (graphFile) {
+        if (!graph.load(path)) {
+            result.error = "Not a valid graph file";
+            return result;
+        }
+        result.places = graph.searchKeys().size();
+    } else if (graph.load(cacheFile)) {
+        result.places = graph.searchKeys().size();
+    } else {
+        OsmImporter importer;
+        if (!importer.load(path)) {
+            result.error = importer.errorString();
+            return result;
+        }
+        graph = importer.graph();
+        result.places = importer.placeCount();
+        graph.save(cacheFile);
+    }
 
-    graph[12].push_back(Edge(18, nodes[12].coord.distanceTo(nodes[18].coord), 80.0, "Metro Line"));
-    graph[18].push_back(Edge(12, nodes[12].coord.distanceTo(nodes[18].coord), 80.0, "Metro Line"));
+    if (graph.nodeCount() == 0) {
+        result.error = "The file contains no drivable roads";
+    } else {
+        result.snapshot = GraphSnapshot::create(graph);
+        result.layers = MapView::buildLayers(result.snapshot);
+    }
+    return result;
+}
 
-    graph[20].push_back(Edge(24, nodes[20].coord.distanceTo(nodes[24].coord), 60.0, "Ring Road"));
-    graph[24].push_back(Edge(20, nodes[20].coord.distanceTo(nodes[24].coord), 60.0, "Ring Road"));
+void MainWindow::onOpenMapClicked()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Open map", QString(),
+                                                "Maps (*.osm *.osm.pbf *.pbf *.rgraph);;All files (*)");
+    if (!path.isEmpty()) {
+        openMap(path);
+    }
+}
 
-    searchEngine->buildIndex(nodes);
-    router->setGraph(graph, nodes);
+void MainWindow::onMapImported()
+{
+    btnOpenMap->setEnabled(true);
 
-    mapView->setNodes(nodes);
-    mapView->setGraph(graph);
-    mapView->centerOn(nodes[12].coord);
+    MapImport result = importWatcher->result();
+    if (!result.snapshot) {
+        statusLabel->setText("Could not load map");
+        QMessageBox::warning(this, "Open Map", QString("Could not load %1:\n%2")
+                                                   .arg(QFileInfo(result.path).fileName(), result.error));
+        return;
+    }
 
-    statusLabel->setText(QString("Loaded %1 locations | Search or click on map").arg(nodes.size()));
+    // Start at the middle of the imported area
+    const RoadGraph& graph = result.snapshot->graph();
+    double minLat = graph.coord(0).lat, maxLat = minLat;
+    double minLon = graph.coord(0).lon, maxLon = minLon;
+    for (int u = 1; u < graph.nodeCount(); u++) {
+        const GeoCoord coord = graph.coord(u);
+        minLat = std::min(minLat, coord.lat);
+        maxLat = std::max(maxLat, coord.lat);
+        minLon = std::min(minLon, coord.lon);
+        maxLon = std::max(maxLon, coord.lon);
+    }
+    showGraph(result.snapshot, result.layers,
+              GeoCoord((minLat + maxLat) / 2.0, (minLon + maxLon) / 2.0), result.tilePack, result.hierarchy);
+
+    statusLabel->setText(QString("Loaded %1 | %2 junctions, %3 road segments, %4 places")
+                             .arg(QFileInfo(result.path).fileName())
+                             .arg(graph.nodeCount())
+                             .arg(graph.edgeCount())
+                             .arg(result.places));
 }
 
 void MainWindow::onSearchTextChanged(const QString& text)
@@ -397,39 +598,103 @@ void MainWindow::onSearchResultSelected(QListWidgetItem* item)
     searchBox->clear();
 }
 
+void MainWindow::onNodeClicked(int nodeId)
+{
+    QString name = router->graphSnapshot()->graph().nodeName(nodeId);
+    statusLabel->setText(name.isEmpty() ? QString("Selected: Node %1").arg(nodeId)
+                                        : QString("Selected: %1 (Node %2)").arg(name).arg(nodeId));
+}
+
+void MainWindow::onRoadClicked(const GeoCoord& coord)
+{
+    statusLabel->setText(QString("Selected: road at %1, %2").arg(coord.lat, 0, 'f', 5).arg(coord.lon, 0, 'f', 5));
+}
+
+MainWindow::Waypoint MainWindow::selection() const
+{
+    Waypoint waypoint;
+    waypoint.node = mapView->getHighlightedNode();
+    if (waypoint.node < 0 && mapView->hasHighlightedPoint()) {
+        waypoint.onRoad = true;
+        waypoint.point = mapView->getHighlightedPoint();
+    }
+    return waypoint;
+}
+
 void MainWindow::onSetStartClicked()
 {
-    int highlightedNode = mapView->getHighlightedNode();
-    if (highlightedNode >= 0) {
-        startNodeId = highlightedNode;
-        statusLabel->setText(QString("Start set: Node %1").arg(startNodeId));
+    Waypoint selected = selection();
+    if (selected.node >= 0) {
+        routeStart = selected;
+        statusLabel->setText(QString("Start set: Node %1").arg(selected.node));
+    } else if (selected.onRoad) {
+        routeStart = selected;
+        statusLabel->setText("Start set: point on a road");
     } else {
-        QMessageBox::warning(this, "No Selection", "Please search and select a location first.");
+        QMessageBox::warning(this, "No Selection", "Please search for or click on a location first.");
     }
 }
 
 void MainWindow::onSetEndClicked()
 {
-    int highlightedNode = mapView->getHighlightedNode();
-    if (highlightedNode >= 0) {
-        endNodeId = highlightedNode;
-        statusLabel->setText(QString("End set: Node %1").arg(endNodeId));
+    Waypoint selected = selection();
+    if (selected.node >= 0) {
+        routeEnd = selected;
+        statusLabel->setText(QString("End set: Node %1").arg(selected.node));
+    } else if (selected.onRoad) {
+        routeEnd = selected;
+        statusLabel->setText("End set: point on a road");
     } else {
-        QMessageBox::warning(this, "No Selection", "Please search and select a location first.");
+        QMessageBox::warning(this, "No Selection", "Please search for or click on a location first.");
     }
 }
 
 void MainWindow::onFindRouteClicked()
 {
-    if (startNodeId < 0 || endNodeId < 0) {
+    if (!routeStart.isSet() || !routeEnd.isSet()) {
         QMessageBox::warning(this, "Missing Locations",
                              "Please set both start and end locations.");
         return;
     }
 
-    auto route = router->findRoute(startNodeId, endNodeId);
+    // Supersedes, and cancels, any search still running. A node snaps onto
+    // a road at its own position, so mixed ends route between positions.
+    if (!routeStart.onRoad && !routeEnd.onRoad) {
+        pendingRequestId = router->findRouteAsync(routeStart.node, routeEnd.node);
+    } else {
+        auto position = [this](const Waypoint& waypoint) {
+            return waypoint.onRoad ? waypoint.point : router->getNodeCoord(waypoint.node);
+        };
+        pendingRequestId = router->findRouteAsync(position(routeStart), position(routeEnd));
+    }
+    routeClock.start();
+    progressTimer->start();
+    onRouteProgress();
+}
+
+void MainWindow::onRouteProgress()
+{
+    statusLabel->setText(QString("Searching... %1 nodes settled | %2 s")
+                             .arg(router->routingProgress())
+                             .arg(routeClock.elapsed() / 1000.0, 0, 'f', 1));
+}
+
+void MainWindow::onRouteFinished(const RouteResult& result)
+{
+    // Results of superseded requests arrive cancelled or late; drop them
+    if (result.requestId != pendingRequestId) {
+        return;
+    }
+    progressTimer->stop();
+
+    if (result.cancelled) {
+        statusLabel->setText("Route search cancelled");
+        return;
+    }
 
+    const auto& route = result.steps;
     if (route.empty()) {
+        statusLabel->setText("Ready");
         QMessageBox::information(this, "No Route", "Could not find a route.");
         return;
     }
@@ -456,9 +721,106 @@ void MainWindow::onFindRouteClicked()
     }
 
     // Show distance and time (removed steps)
-    statusLabel->setText(QString("Route found: %1 km | %2")
+    statusLabel->setText(QString("Route found: %1 km | %2 | %3 nodes settled in %4 ms")
                              .arg(totalDist / 1000.0, 0, 'f', 2)
-                             .arg(timeStr));
+                             .arg(timeStr)
+                             .arg(result.stats.settledNodes)
+                             .arg(routeClock.elapsed()));
+}
+
+void MainWindow::onReachableClicked()
+{
+    int origin = routeStart.node >= 0 ? routeStart.node : mapView->getHighlightedNode();
+    if (origin < 0) {
+        QMessageBox::warning(this, "No Selection", "Please set a start or select a location first.");
+        return;
+    }
+
+    // 5, 10 and 15 minute areas from a single search. A newer request
+    // replaces the future, so only its areas arrive.
+    reachOrigin = origin;
+    reachWatcher->setFuture(router->isochronesAsync(origin, {5 * 60.0, 10 * 60.0, 15 * 60.0}));
+    statusLabel->setText(QString("Finding what is reachable from node %1...").arg(origin));
+}
+
+void MainWindow::onReachableFinished()
+{
+    // Areas of a graph since replaced mean nothing
+    if (reachOrigin < 0) {
+        return;
+    }
+
+    std::vector<Isochrone> areas = reachWatcher->result();
+    mapView->setIsochrones(areas);
+
+    statusLabel->setText(QString("Reachable from node %1: %2 / %3 / %4 locations within 5 / 10 / 15 mins")
+                             .arg(reachOrigin)
+                             .arg(areas[0].nodes.size())
+                             .arg(areas[1].nodes.size())
+                             .arg(areas[2].nodes.size()));
+}
+
+void MainWindow::onRoutingModeChanged(int index)
+{
+    switch (index) {
+    case 1:
+        router->setRoutingMode(RoutingMode::AStar);
+        router->setMetric(RouteMetric::Distance);
+        break;
+    case 2:
+        router->setRoutingMode(RoutingMode::AStar);
+        router->setMetric(RouteMetric::TravelTime);
+        break;
+    case 3:
+        router->setRoutingMode(RoutingMode::Bidirectional);
+        router->setMetric(RouteMetric::Distance);
+        break;
+    case 4:
+        router->setRoutingMode(RoutingMode::ContractionHierarchy);
+        router->setMetric(RouteMetric::TravelTime);
+        prepareContractionHierarchy();
+        break;
+    case 5:
+        router->setRoutingMode(RoutingMode::ALT);
+        router->setMetric(RouteMetric::TravelTime);
+        if (!router->hasLandmarks()) {
+            statusLabel->setText("Choosing landmarks...");
+            router->prepareAsync(RoutingMode::ALT, RouteMetric::TravelTime);
+        }
+        break;
+    default:
+        router->setRoutingMode(RoutingMode::Dijkstra);
+        router->setMetric(RouteMetric::Distance);
+        break;
+    }
+}
+
+void MainWindow::prepareContractionHierarchy()
+{
+    if (router->hasContractionHierarchy()) {
+        return;
+    }
+
+    // Reuse the hierarchy from a previous run of this map; the built-in
+    // sample has no file and contracts in no time
+    statusLabel->setText("Preparing contraction hierarchy...");
+    router->prepareAsync(RoutingMode::ContractionHierarchy, RouteMetric::TravelTime, hierarchyFile);
+}
+
+void MainWindow::onPrepareFinished(RoutingMode mode, RouteMetric metric, bool fromCache)
+{
+    // Only worth reporting while the mode is still selected
+    if (mode != router->routingMode() || metric != router->routeMetric()) {
+        return;
+    }
+
+    if (mode == RoutingMode::ContractionHierarchy) {
+        statusLabel->setText(QString("%1 contraction hierarchy (%2 shortcuts)")
+                                 .arg(fromCache ? "Loaded" : "Built")
+                                 .arg(router->contractionShortcutCount()));
+    } else if (mode == RoutingMode::ALT) {
+        statusLabel->setText("Landmarks ready");
+    }
 }
 
 void MainWindow::onZoomInClicked()
@@ -475,9 +837,7 @@ void MainWindow::onResetViewClicked()
 {
     if (!router) return;
 
-    // Reset to center node (Main Square)
-    GeoCoord center = router->getNodeCoord(12);
-    mapView->centerOn(center);
+    mapView->centerOn(homeCoord);
     mapView->resetZoom();
-    statusLabel->setText("View reset to Main Square");
+    statusLabel->setText("View reset");
 }
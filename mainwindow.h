@@ -6,6 +6,10 @@
 #include <QPushButton>
 #include <QListWidget>
 #include <QLabel>
+#include <QComboBox>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include "mapview.h"
 #include "searchengine.h"
 #include "router.h"
@@ -17,12 +21,40 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Loads an OpenStreetMap extract or a saved graph file (.rgraph) in the
+    // background and shows it once ready; the current map stays usable
+    // until then
+    void openMap(const QString& path);
+
+    struct MapImport {
+        GraphSnapshotPtr snapshot;
+        MapView::GraphLayers layers;
+        QString path;
+        QString tilePack;       // Where the map's rendered tiles are kept
+        QString hierarchy;      // Where its travel time hierarchy is kept
+        QString error;
+        int places = 0;
+    };
+
+    // Loads a map file the way openMap() does, in the calling thread
+    static MapImport importMap(const QString& path);
+
 private slots:
     void onSearchTextChanged(const QString& text);
     void onSearchResultSelected(QListWidgetItem* item);
+    void onNodeClicked(int nodeId);
+    void onRoadClicked(const GeoCoord& coord);
     void onSetStartClicked();
     void onSetEndClicked();
     void onFindRouteClicked();
+    void onRouteFinished(const RouteResult& result);
+    void onRouteProgress();
+    void onRoutingModeChanged(int index);
+    void onPrepareFinished(RoutingMode mode, RouteMetric metric, bool fromCache);
+    void onReachableClicked();
+    void onReachableFinished();
+    void onOpenMapClicked();
+    void onMapImported();
     void onZoomInClicked();
     void onZoomOutClicked();
     void onResetViewClicked();
@@ -30,6 +62,10 @@ private slots:
 private:
     void setupUI();
     void loadSampleData();
+    void showGraph(const GraphSnapshotPtr& snapshot, const MapView::GraphLayers& layers,
+                   const GeoCoord& home, const QString& tilePack = QString(),
+                   const QString& hierarchy = QString());
+    void prepareContractionHierarchy();
     void applyStyles();
 
     MapView* mapView;
@@ -41,13 +77,42 @@ private:
     QPushButton* btnSetStart;
     QPushButton* btnSetEnd;
     QPushButton* btnFindRoute;
+    QComboBox* routingModeBox;
+    QPushButton* btnReachable;
+    QPushButton* btnOpenMap;
     QPushButton* btnZoomIn;
     QPushButton* btnZoomOut;
     QPushButton* btnResetView;
     QLabel* statusLabel;
 
-    int startNodeId;
-    int endNodeId;
+    // Where a route starts or ends: a node, or with node -1 and onRoad set a
+    // point along a road
+    struct Waypoint {
+        int node = -1;
+        bool onRoad = false;
+        GeoCoord point;
+
+        bool isSet() const { return node >= 0 || onRoad; }
+    };
+
+    // The node or road point last clicked or found, as a waypoint
+    Waypoint selection() const;
+
+    Waypoint routeStart;
+    Waypoint routeEnd;
+    GeoCoord homeCoord;
+    // Contraction hierarchy cache of the map shown, empty for none
+    QString hierarchyFile;
+
+    // The route request whose result will be shown
+    quint64 pendingRequestId;
+    QTimer* progressTimer;
+    QElapsedTimer routeClock;
+
+    QFutureWatcher<MapImport>* importWatcher;
+    // Reachable areas being computed, from reachOrigin; -1 drops the result
+    QFutureWatcher<std::vector<Isochrone>>* reachWatcher;
+    int reachOrigin;
 };
 
 #endif // MAINWINDOW_H
@@ -3,18 +3,41 @@
 #include <QPainterPath>
 #include <QMouseEvent>
 #include <QWheelEvent>
+#include <QPolygonF>
+#include <QtConcurrent>
+#include <algorithm>
 #include <cmath>
 
+namespace {
+
+// Pixels rendered beyond each side of the viewport, so panning can reuse
+// the cached base layer
+const int BaseMargin = 256;
+
+// Smallest scale at which junctions get a marker
+const double MinJunctionScale = 0.1;
+
+} // namespace
+
 MapView::MapView(QWidget *parent)
     : QWidget(parent),
     centerCoord(28.6139, 77.2090),
     zoomLevel(12),
     scale(0.3),
     isPanning(false),
-    highlightedNode(-1)
+    highlightedNode(-1),
+    highlightedPointSet(false),
+    tileManager(new TileManager(this)),
+    labelEngine(std::make_shared<const LabelEngine>()),
+    clusterIndex(std::make_shared<const ClusterIndex>()),
+    baseVersion(1),
+    baseWatcher(new QFutureWatcher<BaseLayer>(this))
 {
     setMinimumSize(600, 400);
     setMouseTracking(true);
+
+    connect(tileManager, &TileManager::tileReady, this, [this]() { update(); });
+    connect(baseWatcher, &QFutureWatcher<BaseLayer>::finished, this, &MapView::onBaseLayerRendered);
 }
 
 void MapView::centerOn(const GeoCoord& coord)
@@ -23,15 +46,34 @@ void MapView::centerOn(const GeoCoord& coord)
     update();
 }
 
-void MapView::setNodes(const std::vector<Node>& n)
+MapView::GraphLayers MapView::buildLayers(const GraphSnapshotPtr& snapshot)
 {
-    nodes = n;
+    GraphLayers layers;
+    layers.roads = snapshot ? std::make_shared<const RoadLayer>(*snapshot)
+                            : std::make_shared<const RoadLayer>();
+    layers.labels = snapshot ? std::make_shared<const LabelEngine>(*snapshot)
+                             : std::make_shared<const LabelEngine>();
+    layers.clusters = snapshot ? std::make_shared<const ClusterIndex>(*snapshot)
+                               : std::make_shared<const ClusterIndex>();
+    return layers;
+}
+
+void MapView::setGraph(const GraphSnapshotPtr& g, const GraphLayers& layers)
+{
+    snapshot = g;
+    highlightedPointSet = false;
+    tileManager->setRoadLayer(layers.roads);
+    labelEngine = layers.labels;
+    clusterIndex = layers.clusters;
+    // The old graph's places would show over the new roads
+    baseLayer = BaseLayer();
+    baseVersion++;
     update();
 }
 
-void MapView::setGraph(const AdjacencyList& g)
+void MapView::setTilePack(const QString& path)
 {
-    graph = g;
+    tileManager->setTilePack(path);
     update();
 }
 
@@ -41,9 +83,29 @@ void MapView::setRoute(const std::vector<RouteStep>& r)
     update();
 }
 
+void MapView::setIsochrones(const std::vector<Isochrone>& areas)
+{
+    isochrones = areas;
+
+    // Largest first so the smaller areas stay visible on top
+    std::sort(isochrones.begin(), isochrones.end(),
+              [](const Isochrone& a, const Isochrone& b) { return a.budget > b.budget; });
+    baseVersion++;
+    update();
+}
+
 void MapView::setHighlightNode(int nodeId)
 {
     highlightedNode = nodeId;
+    highlightedPointSet = false;
+    update();
+}
+
+void MapView::setHighlightPoint(const GeoCoord& coord)
+{
+    highlightedNode = -1;
+    highlightedPoint = coord;
+    highlightedPointSet = true;
     update();
 }
 
@@ -51,51 +113,40 @@ void MapView::paintEvent(QPaintEvent* event)
 {
     Q_UNUSED(event);
 
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
+    // A new graph or new areas are rendered in the background like a pan.
+    // Until then the layer on screen stays, or none after a graph change;
+    // a render already running for an older version is dropped when it
+    // finishes, and the next paint starts this one.
+    if ((baseLayer.version != baseVersion || baseLayerStale()) && !baseWatcher->isRunning()) {
+        baseWatcher->setFuture(QtConcurrent::run(&MapView::renderBaseLayer, baseRequest()));
+    }
 
-    // Clean background
-    QLinearGradient gradient(0, 0, 0, height());
-    gradient.setColorAt(0, QColor(248, 249, 250));
-    gradient.setColorAt(1, QColor(241, 243, 245));
-    painter.fillRect(rect(), gradient);
+    QPainter painter(this);
 
-    // Subtle grid
-    painter.setPen(QPen(QColor(220, 225, 230), 1, Qt::DotLine));
-    for (int i = 0; i < width(); i += 50) {
-        painter.drawLine(i, 0, i, height());
+    const qreal ratio = devicePixelRatioF();
+    if (background.size() != size() * ratio || background.devicePixelRatio() != ratio) {
+        background = renderBackground(size(), ratio);
     }
-    for (int i = 0; i < height(); i += 50) {
-        painter.drawLine(0, i, width(), i);
+    painter.drawPixmap(0, 0, background);
+
+    drawRoadTiles(painter);
+
+    // Blit the cached layer, offset by panning and stretched by any zoom
+    // since it was rendered
+    if (!baseLayer.image.isNull()) {
+        const qreal stretch = scale / baseLayer.scale;
+        const QSizeF imageSize = QSizeF(baseLayer.image.size()) / baseLayer.image.devicePixelRatio();
+        painter.save();
+        painter.translate(geoToScreen(baseLayer.center));
+        painter.scale(stretch, stretch);
+        painter.drawImage(QPointF(-imageSize.width() / 2, -imageSize.height() / 2), baseLayer.image);
+        painter.restore();
     }
 
-    // Draw roads
-    for (size_t idx = 0; idx < nodes.size(); ++idx) {
-        const Node& node = nodes[idx];
-
-        if (graph.find(node.id) != graph.end()) {
-            for (const auto& edge : graph.at(node.id)) {
-                if (edge.toNode < static_cast<int>(nodes.size())) {
-                    QPointF pos1 = geoToScreen(node.coord);
-                    QPointF pos2 = geoToScreen(nodes[edge.toNode].coord);
-
-                    if (edge.speed >= 70.0) {
-                        // Highways - orange
-                        painter.setPen(QPen(QColor(255, 167, 38, 180), 6, Qt::SolidLine, Qt::RoundCap));
-                        painter.drawLine(pos1, pos2);
-                        painter.setPen(QPen(QColor(255, 193, 7), 4));
-                        painter.drawLine(pos1, pos2);
-                    } else {
-                        // Regular roads - gray
-                        painter.setPen(QPen(QColor(189, 195, 199), 5, Qt::SolidLine, Qt::RoundCap));
-                        painter.drawLine(pos1, pos2);
-                        painter.setPen(QPen(QColor(236, 240, 241), 3));
-                        painter.drawLine(pos1, pos2);
-                    }
-                }
-            }
-        }
-    }
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    static const RoadGraph emptyGraph;
+    const RoadGraph& graph = snapshot ? snapshot->graph() : emptyGraph;
 
     // Draw route
     if (!route.empty()) {
@@ -103,6 +154,9 @@ void MapView::paintEvent(QPaintEvent* event)
         routePath.moveTo(geoToScreen(route[0].location));
 
         for (size_t i = 1; i < route.size(); i++) {
+            for (const GeoCoord& point : route[i].shape) {
+                routePath.lineTo(geoToScreen(point));
+            }
             routePath.lineTo(geoToScreen(route[i].location));
         }
 
@@ -120,8 +174,11 @@ void MapView::paintEvent(QPaintEvent* event)
 
         // Distance labels - Always show
         for (size_t i = 1; i < route.size(); i++) {
-            QPointF pos1 = geoToScreen(route[i-1].location);
-            QPointF pos2 = geoToScreen(route[i].location);
+            // Middle segment of the step's polyline
+            const std::vector<GeoCoord>& shape = route[i].shape;
+            const size_t middle = shape.size() / 2;
+            QPointF pos1 = geoToScreen(middle == 0 ? route[i-1].location : shape[middle - 1]);
+            QPointF pos2 = geoToScreen(middle == shape.size() ? route[i].location : shape[middle]);
             QPointF midpoint = (pos1 + pos2) / 2.0;
 
             QString distText;
@@ -172,67 +229,21 @@ void MapView::paintEvent(QPaintEvent* event)
         }
     }
 
-    // Draw nodes
-    for (const auto& node : nodes) {
-        QPointF pos = geoToScreen(node.coord);
-
-        painter.setBrush(QColor(0, 0, 0, 40));
-        painter.setPen(Qt::NoPen);
-        painter.drawEllipse(pos + QPointF(2, 2), 6, 6);
-
-        if (node.id == highlightedNode) {
-            painter.setBrush(QColor(231, 76, 60));
-            painter.setPen(QPen(Qt::white, 3));
-            painter.drawEllipse(pos, 14, 14);
-            painter.setBrush(Qt::white);
-            painter.drawEllipse(pos, 5, 5);
-        } else if (!node.name.isEmpty() && !node.name.contains("Junction")) {
-            painter.setBrush(QColor(52, 152, 219));
-            painter.setPen(QPen(Qt::white, 2));
-            painter.drawEllipse(pos, 7, 7);
-        } else {
-            painter.setBrush(QColor(149, 165, 166));
-            painter.setPen(QPen(Qt::white, 1));
-            painter.drawEllipse(pos, 3, 3);
-        }
-    }
-
-    // Draw labels - Always show
-    if (scale > 0.1) {
-        for (const auto& node : nodes) {
-            if (!node.name.isEmpty() && !node.name.contains("Junction")) {
-                QPointF pos = geoToScreen(node.coord);
-
-                QFont font("Arial", 9, QFont::Bold);
-                painter.setFont(font);
-                QFontMetrics fm(font);
-                int textWidth = fm.horizontalAdvance(node.name);
-                int textHeight = fm.height();
-
-                double offsetY = (node.id % 2 == 0) ? 18 : -24;
-
-                QRectF labelRect(pos.x() - textWidth/2 - 6,
-                                 pos.y() + offsetY - textHeight/2,
-                                 textWidth + 12, textHeight + 4);
-
-                painter.setBrush(QColor(0, 0, 0, 70));
-                painter.setPen(Qt::NoPen);
-                painter.drawRoundedRect(labelRect.adjusted(1, 1, 1, 1), 3, 3);
+    // Highlighted node or point on a road
+    if (graph.hasNode(highlightedNode) || highlightedPointSet) {
+        QPointF pos = geoToScreen(highlightedPointSet ? highlightedPoint : graph.coord(highlightedNode));
 
-                painter.setBrush(QColor(44, 62, 80, 250));
-                painter.setPen(QPen(QColor(52, 73, 94), 1));
-                painter.drawRoundedRect(labelRect, 3, 3);
-
-                painter.setPen(Qt::white);
-                painter.drawText(labelRect, Qt::AlignCenter, node.name);
-            }
-        }
+        painter.setBrush(QColor(231, 76, 60));
+        painter.setPen(QPen(Qt::white, 3));
+        painter.drawEllipse(pos, 14, 14);
+        painter.setBrush(Qt::white);
+        painter.drawEllipse(pos, 5, 5);
     }
 
     // Info panel
     QString info = QString("Zoom: %1 | %2 locations")
                        .arg(static_cast<int>(scale * 100))
-                       .arg(nodes.size());
+                       .arg(graph.nodeCount());
 
     painter.setFont(QFont("Arial", 9));
     QFontMetrics fm(painter.font());
@@ -247,25 +258,319 @@ void MapView::paintEvent(QPaintEvent* event)
     painter.drawText(infoRect, Qt::AlignCenter, info);
 }
 
-QPointF MapView::geoToScreen(const GeoCoord& coord) const
+void MapView::drawRoadTiles(QPainter& painter)
+{
+    tileManager->setDevicePixelRatio(devicePixelRatioF());
+
+    const QTransform toScreen = worldTransform(centerCoord, scale, QSizeF(size()));
+    const QRectF worldView = toScreen.inverted().mapRect(QRectF(rect()));
+    const int zoom = TileManager::zoomForScale(scale);
+    const std::vector<TileCoord> visible = TileManager::tilesIn(worldView, zoom);
+
+    painter.save();
+    painter.setTransform(toScreen);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+    for (const TileCoord& tile : visible) {
+        const QRectF area = TileManager::worldRect(tile);
+        QImage image = tileManager->tile(tile);
+        if (!image.isNull()) {
+            painter.drawImage(area, image);
+            continue;
+        }
+
+        // Until it is ready, stretch the matching part of a coarser tile
+        for (int up = 1; up <= 3; up++) {
+            const TileCoord parent(tile.x >> up, tile.y >> up, tile.zoom - up);
+            QImage coarse = tileManager->tile(parent);
+            if (!coarse.isNull()) {
+                const QRectF parentArea = TileManager::worldRect(parent);
+                const double pixels = coarse.width() / parentArea.width();
+                painter.drawImage(area, coarse,
+                                  QRectF((area.left() - parentArea.left()) * pixels,
+                                         (area.top() - parentArea.top()) * pixels,
+                                         area.width() * pixels, area.height() * pixels));
+                break;
+            }
+        }
+    }
+    painter.restore();
+
+    // Prefetch the row or column the pan is about to uncover. Dragging
+    // right reveals tiles to the west, so step against the drag.
+    std::vector<TileCoord> ahead;
+    if (!visible.empty()) {
+        const TileCoord& first = visible.front();
+        const TileCoord& last = visible.back();
+        if (panDelta.x() != 0) {
+            const int x = panDelta.x() > 0 ? first.x - 1 : last.x + 1;
+            for (int y = first.y; y <= last.y; y++) {
+                ahead.emplace_back(x, y, zoom);
+            }
+        }
+        if (panDelta.y() != 0) {
+            const int y = panDelta.y() > 0 ? first.y - 1 : last.y + 1;
+            for (int x = first.x; x <= last.x; x++) {
+                ahead.emplace_back(x, y, zoom);
+            }
+        }
+    }
+    tileManager->request(visible, ahead);
+}
+
+MapView::BaseRequest MapView::baseRequest() const
 {
-    double x = (coord.lon - centerCoord.lon) * 100000.0 * scale + width() / 2.0;
-    double y = (centerCoord.lat - coord.lat) * 100000.0 * scale + height() / 2.0;
+    BaseRequest request;
+    request.snapshot = snapshot;
+    request.labels = labelEngine;
+    request.clusters = clusterIndex;
+    request.isochrones = isochrones;
+    request.center = centerCoord;
+    request.scale = scale;
+    request.size = size() + QSize(2 * BaseMargin, 2 * BaseMargin);
+    request.pixelRatio = devicePixelRatioF();
+    request.version = baseVersion;
+    return request;
+}
+
+bool MapView::baseLayerStale() const
+{
+    if (baseLayer.image.isNull() || baseLayer.scale != scale) {
+        return true;
+    }
+
+    // Start the next one while the pan still has half the margin to go
+    const QSizeF imageSize = QSizeF(baseLayer.image.size()) / baseLayer.image.devicePixelRatio();
+    const QPointF center = geoToScreen(baseLayer.center);
+    const QRectF covered(center.x() - imageSize.width() / 2, center.y() - imageSize.height() / 2,
+                         imageSize.width(), imageSize.height());
+    return !covered.adjusted(BaseMargin / 2, BaseMargin / 2, -BaseMargin / 2, -BaseMargin / 2)
+                .contains(QRectF(rect()));
+}
+
+void MapView::onBaseLayerRendered()
+{
+    BaseLayer rendered = baseWatcher->result();
+
+    // Rendered from a graph or areas that have been replaced since
+    if (rendered.version == baseVersion) {
+        baseLayer = std::move(rendered);
+    }
+    update();
+}
+
+QPixmap MapView::renderBackground(const QSize& size, qreal pixelRatio)
+{
+    QPixmap pixmap(size * pixelRatio);
+    pixmap.setDevicePixelRatio(pixelRatio);
+    QPainter painter(&pixmap);
+
+    // Clean background
+    QLinearGradient gradient(0, 0, 0, size.height());
+    gradient.setColorAt(0, QColor(248, 249, 250));
+    gradient.setColorAt(1, QColor(241, 243, 245));
+    painter.fillRect(QRect(QPoint(0, 0), size), gradient);
+
+    // Subtle grid
+    painter.setPen(QPen(QColor(220, 225, 230), 1, Qt::DotLine));
+    for (int i = 0; i < size.width(); i += 50) {
+        painter.drawLine(i, 0, i, size.height());
+    }
+    for (int i = 0; i < size.height(); i += 50) {
+        painter.drawLine(0, i, size.width(), i);
+    }
+    return pixmap;
+}
+
+MapView::BaseLayer MapView::renderBaseLayer(const BaseRequest& request)
+{
+    BaseLayer layer;
+    layer.center = request.center;
+    layer.scale = request.scale;
+    layer.version = request.version;
+    layer.image = QImage(request.size * request.pixelRatio, QImage::Format_ARGB32_Premultiplied);
+    layer.image.setDevicePixelRatio(request.pixelRatio);
+
+    const QSizeF size(request.size);
+    auto toScreen = [&request, &size](const GeoCoord& coord) {
+        return project(coord, request.center, request.scale, size);
+    };
+    auto toGeo = [&request, &size](const QPointF& point) {
+        return unproject(point, request.center, request.scale, size);
+    };
+
+    static const RoadGraph emptyGraph;
+    const RoadGraph& graph = request.snapshot ? request.snapshot->graph() : emptyGraph;
+
+    layer.image.fill(Qt::transparent);
+    QPainter painter(&layer.image);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    // Only nodes in or near the image are drawn. The margins cover node
+    // markers and the labels beside them. Zoomed out, junctions would only
+    // bury the roads under dots, so they are left out.
+    const QPointF nearTopLeft(-120, -40);
+    const QPointF nearBottomRight(size.width() + 120, size.height() + 40);
+    std::vector<int> visibleJunctions;
+    if (request.snapshot && request.scale >= MinJunctionScale) {
+        for (int u : request.snapshot->spatialIndex().nodesInBox(toGeo(nearTopLeft), toGeo(nearBottomRight))) {
+            if (!graph.hasName(u) || graph.nodeName(u).contains("Junction")) {
+                visibleJunctions.push_back(u);
+            }
+        }
+    }
+
+    // Places come merged into clusters, down to single ones zoomed in
+    std::vector<ClusterIndex::Cluster> visiblePlaces;
+    request.clusters->query(QRectF(RoadLayer::toWorld(toGeo(nearTopLeft)),
+                                   RoadLayer::toWorld(toGeo(nearBottomRight))),
+                            request.scale, visiblePlaces);
+
+    // Draw reachability areas, shading from green (near) to red (far)
+    const std::vector<Isochrone>& isochrones = request.isochrones;
+    for (size_t i = 0; i < isochrones.size(); i++) {
+        if (isochrones[i].polygon.size() < 3) {
+            continue;
+        }
+
+        QPolygonF polygon;
+        for (const auto& coord : isochrones[i].polygon) {
+            polygon << toScreen(coord);
+        }
+
+        double t = isochrones.size() > 1 ? static_cast<double>(i) / (isochrones.size() - 1) : 1.0;
+        QColor fill(static_cast<int>(231 - t * 192), static_cast<int>(76 + t * 98),
+                    static_cast<int>(60 + t * 36), 70);
+
+        painter.setBrush(fill);
+        painter.setPen(QPen(fill.darker(130), 2));
+        painter.drawPolygon(polygon);
+    }
+
+    // Draw junctions
+    for (int u : visibleJunctions) {
+        QPointF pos = toScreen(graph.coord(u));
+
+        painter.setBrush(QColor(0, 0, 0, 40));
+        painter.setPen(Qt::NoPen);
+        painter.drawEllipse(pos + QPointF(2, 2), 6, 6);
+
+        painter.setBrush(QColor(149, 165, 166));
+        painter.setPen(QPen(Qt::white, 1));
+        painter.drawEllipse(pos, 3, 3);
+    }
+
+    // Draw places, and clusters as bubbles sized and labelled by their count
+    const QTransform toView = worldTransform(request.center, request.scale, size);
+    const QFont countFont("Arial", 8, QFont::Bold);
+    std::vector<int> singlePlaces;
+    for (const ClusterIndex::Cluster& cluster : visiblePlaces) {
+        const QPointF pos = toView.map(cluster.world);
+
+        if (cluster.count == 1) {
+            singlePlaces.push_back(cluster.node);
+
+            painter.setBrush(QColor(0, 0, 0, 40));
+            painter.setPen(Qt::NoPen);
+            painter.drawEllipse(pos + QPointF(2, 2), 6, 6);
+
+            painter.setBrush(QColor(52, 152, 219));
+            painter.setPen(QPen(Qt::white, 2));
+            painter.drawEllipse(pos, 7, 7);
+            continue;
+        }
+
+        const double radius = 10.0 + 4.0 * std::log10(static_cast<double>(cluster.count));
+        painter.setBrush(QColor(52, 152, 219, 70));
+        painter.setPen(Qt::NoPen);
+        painter.drawEllipse(pos, radius + 5, radius + 5);
+
+        painter.setBrush(QColor(52, 152, 219));
+        painter.setPen(QPen(Qt::white, 2));
+        painter.drawEllipse(pos, radius, radius);
+
+        const QString count = cluster.count < 1000 ? QString::number(cluster.count)
+                                                   : QString("%1k").arg(cluster.count / 1000.0, 0, 'f', 1);
+        painter.setFont(countFont);
+        painter.setPen(Qt::white);
+        painter.drawText(QRectF(pos.x() - radius, pos.y() - radius, 2 * radius, 2 * radius),
+                         Qt::AlignCenter, count);
+    }
+
+    // Draw labels of single places, most important first where they do
+    // not overlap
+    if (request.scale > 0.1) {
+        const std::vector<LabelEngine::Placement> placements = request.labels->place(singlePlaces, toView);
+        request.labels->paint(painter, placements);
+    }
+
+    return layer;
+}
+
+QTransform MapView::worldTransform(const GeoCoord& center, double scale, const QSizeF& size)
+{
+    return QTransform()
+        .translate(size.width() / 2.0, size.height() / 2.0)
+        .scale(scale, scale)
+        .translate(-center.lon * 100000.0, center.lat * 100000.0);
+}
+
+QPointF MapView::project(const GeoCoord& coord, const GeoCoord& center, double scale,
+                         const QSizeF& size)
+{
+    double x = (coord.lon - center.lon) * 100000.0 * scale + size.width() / 2.0;
+    double y = (center.lat - coord.lat) * 100000.0 * scale + size.height() / 2.0;
     return QPointF(x, y);
 }
 
-GeoCoord MapView::screenToGeo(const QPointF& point) const
+GeoCoord MapView::unproject(const QPointF& point, const GeoCoord& center, double scale,
+                            const QSizeF& size)
 {
-    double lon = (point.x() - width() / 2.0) / (100000.0 * scale) + centerCoord.lon;
-    double lat = centerCoord.lat - (point.y() - height() / 2.0) / (100000.0 * scale);
+    double lon = (point.x() - size.width() / 2.0) / (100000.0 * scale) + center.lon;
+    double lat = center.lat - (point.y() - size.height() / 2.0) / (100000.0 * scale);
     return GeoCoord(lat, lon);
 }
 
+QPointF MapView::geoToScreen(const GeoCoord& coord) const
+{
+    return project(coord, centerCoord, scale, QSizeF(size()));
+}
+
+GeoCoord MapView::screenToGeo(const QPointF& point) const
+{
+    return unproject(point, centerCoord, scale, QSizeF(size()));
+}
+
+int MapView::nodeAt(const QPointF& point) const
+{
+    if (!snapshot) {
+        return -1;
+    }
+
+    // The view stretches longitude, so a pixel never spans more ground
+    // than it does north to south
+    const double pickRadius = 16.0;
+    double meters = pickRadius / (100000.0 * scale) * 111195.0;
+
+    int nearest = -1;
+    double nearestSquared = pickRadius * pickRadius;
+    for (int nodeId : snapshot->spatialIndex().nodesWithin(screenToGeo(point), meters)) {
+        QPointF offset = geoToScreen(snapshot->graph().coord(nodeId)) - point;
+        double squared = QPointF::dotProduct(offset, offset);
+        if (squared <= nearestSquared) {
+            nearestSquared = squared;
+            nearest = nodeId;
+        }
+    }
+    return nearest;
+}
+
 void MapView::mousePressEvent(QMouseEvent* event)
 {
     if (event->button() == Qt::LeftButton) {
         isPanning = true;
         lastMousePos = event->pos();
+        pressPos = event->pos();
     }
 }
 
@@ -281,6 +586,7 @@ void MapView::mouseMoveEvent(QMouseEvent* event)
         centerCoord.lon += lonDelta;
 
         lastMousePos = event->pos();
+        panDelta = delta;
         update();
     }
 }
@@ -289,6 +595,23 @@ void MapView::mouseReleaseEvent(QMouseEvent* event)
 {
     if (event->button() == Qt::LeftButton) {
         isPanning = false;
+
+        // Barely moved, so a click rather than a pan
+        if ((event->pos() - pressPos).manhattanLength() <= 4) {
+            int nodeId = nodeAt(event->pos());
+            if (nodeId >= 0) {
+                setHighlightNode(nodeId);
+                emit nodeClicked(nodeId);
+            } else if (snapshot) {
+                // Off the nodes, the nearest road counts within the same 16 pixels
+                EdgeSnap snap = snapshot->spatialIndex().nearestEdge(screenToGeo(event->pos()));
+                QPointF offset = geoToScreen(snap.point) - QPointF(event->pos());
+                if (snap.edge >= 0 && QPointF::dotProduct(offset, offset) <= 16.0 * 16.0) {
+                    setHighlightPoint(snap.point);
+                    emit roadClicked(snap.point);
+                }
+            }
+        }
     }
 }
 
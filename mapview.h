@@ -3,7 +3,18 @@
 
 #include <QWidget>
 #include <QPoint>
+#include <QImage>
+#include <QPixmap>
+#include <QTransform>
+#include <QFutureWatcher>
+#include <memory>
 #include "datatypes.h"
+#include "graphsnapshot.h"
+#include "isochrone.h"
+#include "clusterindex.h"
+#include "labelengine.h"
+#include "roadlayer.h"
+#include "tilemanager.h"
 
 class MapView : public QWidget {
     Q_OBJECT
@@ -11,17 +22,44 @@ class MapView : public QWidget {
 public:
     explicit MapView(QWidget *parent = nullptr);
 
+    // What the view draws a graph with, prepared once per snapshot. It takes
+    // a while on a large map, so it is built on the thread that loads one.
+    struct GraphLayers {
+        std::shared_ptr<const RoadLayer> roads;
+        std::shared_ptr<const LabelEngine> labels;
+        std::shared_ptr<const ClusterIndex> clusters;
+    };
+    // Empty layers for a null snapshot
+    static GraphLayers buildLayers(const GraphSnapshotPtr& snapshot);
+
     void centerOn(const GeoCoord& coord);
-    void setNodes(const std::vector<Node>& nodes);
-    void setGraph(const AdjacencyList& graph);
+    // Shares the snapshot and installs its layers from buildLayers(); a
+    // paint in progress keeps drawing the old ones
+    void setGraph(const GraphSnapshotPtr& snapshot, const GraphLayers& layers);
+    // File keeping the graph's rendered road tiles across runs; set after
+    // setGraph(), which forgets it. An empty path keeps them in memory only.
+    void setTilePack(const QString& path);
     void setRoute(const std::vector<RouteStep>& route);
+    // Filled reachability areas drawn beneath the route; empty clears them
+    void setIsochrones(const std::vector<Isochrone>& isochrones);
     void setHighlightNode(int nodeId);
     int getHighlightedNode() const { return highlightedNode; }
+    // Highlights a point along a road instead of a node
+    void setHighlightPoint(const GeoCoord& coord);
+    bool hasHighlightedPoint() const { return highlightedPointSet; }
+    GeoCoord getHighlightedPoint() const { return highlightedPoint; }
 
     void zoomIn();
     void zoomOut();
     void resetZoom();
 
+signals:
+    // A click, not a drag, landed on or near a node, now highlighted
+    void nodeClicked(int nodeId);
+    // A click missed every node but landed near a road; coord is the
+    // nearest point on it, now highlighted
+    void roadClicked(const GeoCoord& coord);
+
 protected:
     void paintEvent(QPaintEvent* event) override;
     void mousePressEvent(QMouseEvent* event) override;
@@ -29,21 +67,83 @@ protected:
     void mouseReleaseEvent(QMouseEvent* event) override;
     void wheelEvent(QWheelEvent* event) override;
 
+private slots:
+    void onBaseLayerRendered();
+
 private:
+    // Everything the static layers depend on, copied so that they can be
+    // rendered on a worker thread
+    struct BaseRequest {
+        GraphSnapshotPtr snapshot;
+        std::shared_ptr<const LabelEngine> labels;
+        std::shared_ptr<const ClusterIndex> clusters;
+        std::vector<Isochrone> isochrones;
+        GeoCoord center;
+        double scale;
+        QSize size;             // The viewport plus a margin on every side
+        qreal pixelRatio;
+        quint64 version;
+    };
+
+    // Reachability areas, nodes and labels on a transparent image, drawn
+    // around center at scale. Panning and zooming only move and stretch it,
+    // so labels are placed again only after a zoom or a long pan. The road
+    // tiles lie beneath it, the route, the highlight and the info panel
+    // above.
+    struct BaseLayer {
+        QImage image;
+        GeoCoord center;
+        double scale = 0.0;
+        quint64 version = 0;
+    };
+
+    // Composes the cached road tiles covering the viewport and queues the
+    // missing ones, along with those the current pan is heading for
+    void drawRoadTiles(QPainter& painter);
+
+    // The gradient and dotted grid behind the map, fixed to the widget
+    static QPixmap renderBackground(const QSize& size, qreal pixelRatio);
+    static BaseLayer renderBaseLayer(const BaseRequest& request);
+    BaseRequest baseRequest() const;
+    // True after a zoom, or once the viewport nears the edge of the image
+    bool baseLayerStale() const;
+
+    // A view of the map centered on center, scale pixels per 1e-5 degrees
+    static QPointF project(const GeoCoord& coord, const GeoCoord& center, double scale,
+                           const QSizeF& size);
+    static GeoCoord unproject(const QPointF& point, const GeoCoord& center, double scale,
+                              const QSizeF& size);
+    // Maps RoadLayer world coordinates onto such a view
+    static QTransform worldTransform(const GeoCoord& center, double scale, const QSizeF& size);
+
     QPointF geoToScreen(const GeoCoord& coord) const;
     GeoCoord screenToGeo(const QPointF& point) const;
+    // Nearest node within a few pixels of a widget position, or -1
+    int nodeAt(const QPointF& point) const;
 
     GeoCoord centerCoord;
     int zoomLevel;
     double scale;
 
     QPoint lastMousePos;
+    QPoint pressPos;
+    QPoint panDelta;        // Last drag step, for prefetching tiles
     bool isPanning;
 
-    std::vector<Node> nodes;
+    GraphSnapshotPtr snapshot;
     std::vector<RouteStep> route;
-    AdjacencyList graph;
+    std::vector<Isochrone> isochrones;
     int highlightedNode;
+    GeoCoord highlightedPoint;
+    bool highlightedPointSet;
+
+    QPixmap background;     // From renderBackground(), redrawn on resize
+    TileManager* tileManager;
+    std::shared_ptr<const LabelEngine> labelEngine;
+    std::shared_ptr<const ClusterIndex> clusterIndex;
+    BaseLayer baseLayer;
+    quint64 baseVersion;    // Bumped when the graph or the areas change
+    QFutureWatcher<BaseLayer>* baseWatcher;
 };
 
 #endif // MAPVIEW_H
@@ -0,0 +1,125 @@
+#include "nodeorder.h"
+#include <algorithm>
+#include <numeric>
+
+quint64 hilbertIndex(quint32 x, quint32 y)
+{
+    quint64 index = 0;
+    for (quint32 s = 1u << 31; s > 0; s >>= 1) {
+        const quint32 rx = (x & s) ? 1 : 0;
+        const quint32 ry = (y & s) ? 1 : 0;
+        index += static_cast<quint64>(s) * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so the curve stays continuous
+        if (ry == 0) {
+            if (rx == 1) {
+                x = ~x;
+                y = ~y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+namespace {
+
+// Node ids sorted along the Hilbert curve over their bounding box
+std::vector<int> hilbertSequence(const std::vector<GeoCoord>& coords)
+{
+    const int count = static_cast<int>(coords.size());
+    std::vector<int> sequence(count);
+    std::iota(sequence.begin(), sequence.end(), 0);
+    if (count == 0) {
+        return sequence;
+    }
+
+    double minLat = coords[0].lat, maxLat = minLat;
+    double minLon = coords[0].lon, maxLon = minLon;
+    for (const GeoCoord& coord : coords) {
+        minLat = std::min(minLat, coord.lat);
+        maxLat = std::max(maxLat, coord.lat);
+        minLon = std::min(minLon, coord.lon);
+        maxLon = std::max(maxLon, coord.lon);
+    }
+
+    // One square cell size on both axes keeps the curve's locality uniform
+    const double span = std::max(std::max(maxLat - minLat, maxLon - minLon), 1e-9);
+    const double scale = 4294967295.0 / span;
+
+    std::vector<quint64> keys(count);
+    for (int i = 0; i < count; i++) {
+        keys[i] = hilbertIndex(static_cast<quint32>((coords[i].lon - minLon) * scale),
+                               static_cast<quint32>((coords[i].lat - minLat) * scale));
+    }
+    std::stable_sort(sequence.begin(), sequence.end(),
+                     [&keys](int a, int b) { return keys[a] < keys[b]; });
+    return sequence;
+}
+
+} // namespace
+
+std::vector<int> computeNodeOrder(NodeOrder order, const std::vector<GeoCoord>& coords,
+                                  const std::vector<int>& neighbourFirst,
+                                  const std::vector<int>& neighbours)
+{
+    const int count = static_cast<int>(coords.size());
+    std::vector<int> newIds(count);
+
+    if (order == NodeOrder::Insertion) {
+        std::iota(newIds.begin(), newIds.end(), 0);
+        return newIds;
+    }
+
+    const std::vector<int> curve = hilbertSequence(coords);
+    if (order == NodeOrder::Hilbert) {
+        for (int i = 0; i < count; i++) {
+            newIds[curve[i]] = i;
+        }
+        return newIds;
+    }
+
+    // Traversals restart at the first unnumbered node along the curve
+    std::fill(newIds.begin(), newIds.end(), -1);
+    std::vector<int> pending;
+    int nextId = 0;
+
+    for (int root : curve) {
+        if (newIds[root] >= 0) {
+            continue;
+        }
+
+        if (order == NodeOrder::BreadthFirst) {
+            newIds[root] = nextId++;
+            pending.assign(1, root);
+            for (size_t head = 0; head < pending.size(); head++) {
+                const int u = pending[head];
+                for (int i = neighbourFirst[u]; i < neighbourFirst[u + 1]; i++) {
+                    if (newIds[neighbours[i]] < 0) {
+                        newIds[neighbours[i]] = nextId++;
+                        pending.push_back(neighbours[i]);
+                    }
+                }
+            }
+        } else {
+            pending.assign(1, root);
+            while (!pending.empty()) {
+                const int u = pending.back();
+                pending.pop_back();
+                if (newIds[u] >= 0) {
+                    continue;
+                }
+                newIds[u] = nextId++;
+
+                // Pushed in reverse so neighbours are visited in order
+                for (int i = neighbourFirst[u + 1] - 1; i >= neighbourFirst[u]; i--) {
+                    if (newIds[neighbours[i]] < 0) {
+                        pending.push_back(neighbours[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    return newIds;
+}
@@ -0,0 +1,29 @@
+#ifndef NODEORDER_H
+#define NODEORDER_H
+
+#include <QtGlobal>
+#include <vector>
+#include "datatypes.h"
+
+// How RoadGraphBuilder numbers the nodes of the graph it builds. Orders
+// that keep nearby nodes at nearby ids make searches and painting touch
+// fewer cache lines and pages.
+enum class NodeOrder {
+    Insertion,      // The order addNode() was called in
+    Hilbert,        // Along a Hilbert curve over the coordinates
+    BreadthFirst,   // Breadth-first over the roads, one component at a time
+    DepthFirst      // Depth-first over the roads, one component at a time
+};
+
+// Position of (x, y) along the Hilbert curve filling a 2^32 x 2^32 grid
+quint64 hilbertIndex(quint32 x, quint32 y);
+
+// New id for every node: result[oldId] = newId. The undirected neighbours of
+// node u are neighbours[neighbourFirst[u] .. neighbourFirst[u + 1]); the
+// graph orders start each component from its first node along the Hilbert
+// curve, so they still group nearby components together.
+std::vector<int> computeNodeOrder(NodeOrder order, const std::vector<GeoCoord>& coords,
+                                  const std::vector<int>& neighbourFirst,
+                                  const std::vector<int>& neighbours);
+
+#endif // NODEORDER_H
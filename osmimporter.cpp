@@ -0,0 +1,903 @@
+#include "osmimporter.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QXmlStreamReader>
+#include <QThread>
+#include <QtConcurrent>
+#include <unordered_map>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Places snap to the nearest graph node within this distance
+const double MaxPlaceSnap = 2000.0;
+// Grid cell for place snapping, in degrees
+const double SnapCell = 0.01;
+
+const int MaxBlobHeaderSize = 64 * 1024;
+const int MaxBlobSize = 32 * 1024 * 1024;
+
+using Tags = std::vector<std::pair<QString, QString>>;
+
+QString tagValue(const Tags& tags, const char* key)
+{
+    for (const auto& tag : tags) {
+        if (tag.first == QLatin1String(key)) {
+            return tag.second;
+        }
+    }
+    return QString();
+}
+
+struct ParsedWay {
+    std::vector<qint64> refs;
+    double speed;
+    RoadClass roadClass;
+    int oneway;     // 1 along the node order only, -1 against it, 0 both
+    QString name;
+};
+
+struct Place {
+    double lat;
+    double lon;
+    QString name;
+    int rank;       // More important places have lower ranks
+};
+
+// Fills way from the tags of a drivable highway, false for anything else
+bool parseWayTags(const Tags& tags, ParsedWay& way)
+{
+    const QString highway = tagValue(tags, "highway");
+    const double speed = OsmImporter::defaultSpeed(highway);
+    if (speed <= 0.0 || tagValue(tags, "area") == QLatin1String("yes")) {
+        return false;
+    }
+    const QString access = tagValue(tags, "access");
+    if (access == QLatin1String("no") || access == QLatin1String("private")) {
+        return false;
+    }
+
+    way.speed = OsmImporter::parseMaxSpeed(tagValue(tags, "maxspeed"), speed);
+    way.roadClass = OsmImporter::roadClass(highway);
+
+    const QString oneway = tagValue(tags, "oneway");
+    if (oneway == QLatin1String("yes") || oneway == QLatin1String("true") || oneway == QLatin1String("1")) {
+        way.oneway = 1;
+    } else if (oneway == QLatin1String("-1") || oneway == QLatin1String("reverse")) {
+        way.oneway = -1;
+    } else if (oneway == QLatin1String("no")) {
+        way.oneway = 0;
+    } else {
+        way.oneway = highway == QLatin1String("motorway") ||
+                     tagValue(tags, "junction") == QLatin1String("roundabout") ? 1 : 0;
+    }
+
+    way.name = tagValue(tags, "name");
+    if (way.name.isEmpty()) {
+        way.name = tagValue(tags, "ref");
+    }
+    return true;
+}
+
+int placeRank(const QString& place)
+{
+    static const char* const ranked[] = {
+        "city", "town", "village", "suburb", "quarter", "neighbourhood", "hamlet", "locality"
+    };
+    for (int i = 0; i < static_cast<int>(sizeof(ranked) / sizeof(ranked[0])); i++) {
+        if (place == QLatin1String(ranked[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// State carried from the first pass to the second and into the graph
+struct Collector {
+    struct WayInfo {
+        size_t firstRef;
+        int refCount;
+        float speed;
+        RoadClass roadClass;
+        qint8 oneway;
+        int nameId;
+    };
+
+    // First pass: every drivable way with its node references
+    std::vector<qint64> refs;
+    std::vector<WayInfo> ways;
+    std::vector<QString> names;
+    std::unordered_map<QString, int> nameIds;
+
+    // Between passes the references become indices into nodeIds
+    std::vector<qint64> nodeIds;    // Sorted referenced OSM node ids
+    std::vector<int> refIndex;
+    std::vector<quint8> uses;       // Saturating; ends of ways count twice
+
+    // Second pass: coordinates of referenced nodes, named places
+    std::vector<double> lats;
+    std::vector<double> lons;
+    std::vector<char> located;
+    std::vector<Place> places;
+
+    void addWay(ParsedWay& way)
+    {
+        if (way.refs.size() < 2) {
+            return;
+        }
+        auto it = nameIds.find(way.name);
+        if (it == nameIds.end()) {
+            it = nameIds.emplace(way.name, static_cast<int>(names.size())).first;
+            names.push_back(way.name);
+        }
+        ways.push_back({refs.size(), static_cast<int>(way.refs.size()),
+                        static_cast<float>(way.speed), way.roadClass, static_cast<qint8>(way.oneway),
+                        it->second});
+        refs.insert(refs.end(), way.refs.begin(), way.refs.end());
+    }
+
+    void finishWays()
+    {
+        nodeIds = refs;
+        std::sort(nodeIds.begin(), nodeIds.end());
+        nodeIds.erase(std::unique(nodeIds.begin(), nodeIds.end()), nodeIds.end());
+
+        uses.assign(nodeIds.size(), 0);
+        refIndex.resize(refs.size());
+        for (size_t k = 0; k < refs.size(); k++) {
+            refIndex[k] = indexOf(refs[k]);
+            if (uses[refIndex[k]] < 255) uses[refIndex[k]]++;
+        }
+        for (const WayInfo& way : ways) {
+            uses[refIndex[way.firstRef]] = 255;
+            uses[refIndex[way.firstRef + way.refCount - 1]] = 255;
+        }
+        std::vector<qint64>().swap(refs);
+
+        lats.assign(nodeIds.size(), 0.0);
+        lons.assign(nodeIds.size(), 0.0);
+        located.assign(nodeIds.size(), 0);
+    }
+
+    int indexOf(qint64 id) const
+    {
+        auto it = std::lower_bound(nodeIds.begin(), nodeIds.end(), id);
+        return it != nodeIds.end() && *it == id ? static_cast<int>(it - nodeIds.begin()) : -1;
+    }
+
+    // Safe to call from several threads: distinct ids write distinct slots
+    void locate(qint64 id, double lat, double lon)
+    {
+        const int i = indexOf(id);
+        if (i >= 0) {
+            lats[i] = lat;
+            lons[i] = lon;
+            located[i] = 1;
+        }
+    }
+};
+
+bool placeFromTags(const Tags& tags, double lat, double lon, Place& place)
+{
+    place.rank = placeRank(tagValue(tags, "place"));
+    place.name = tagValue(tags, "name");
+    place.lat = lat;
+    place.lon = lon;
+    return place.rank >= 0 && !place.name.isEmpty();
+}
+
+// ---- XML ----------------------------------------------------------------
+
+void readXmlTags(QXmlStreamReader& xml, Tags& tags, std::vector<qint64>* refs)
+{
+    while (xml.readNextStartElement()) {
+        if (xml.name() == QLatin1String("tag")) {
+            tags.push_back({xml.attributes().value("k").toString(),
+                            xml.attributes().value("v").toString()});
+        } else if (refs && xml.name() == QLatin1String("nd")) {
+            refs->push_back(xml.attributes().value("ref").toLongLong());
+        }
+        xml.skipCurrentElement();
+    }
+}
+
+bool readXml(const QString& path, int pass, Collector& collector, QString& error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    QXmlStreamReader xml(&file);
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+
+        if (pass == 1 && xml.name() == QLatin1String("way")) {
+            Tags tags;
+            ParsedWay way;
+            readXmlTags(xml, tags, &way.refs);
+            if (parseWayTags(tags, way)) {
+                collector.addWay(way);
+            }
+        } else if (pass == 2 && xml.name() == QLatin1String("node")) {
+            const qint64 id = xml.attributes().value("id").toLongLong();
+            const double lat = xml.attributes().value("lat").toDouble();
+            const double lon = xml.attributes().value("lon").toDouble();
+            collector.locate(id, lat, lon);
+
+            Tags tags;
+            readXmlTags(xml, tags, nullptr);
+            Place place;
+            if (placeFromTags(tags, lat, lon, place)) {
+                collector.places.push_back(place);
+            }
+        }
+    }
+
+    if (xml.hasError()) {
+        error = QString("%1 at line %2").arg(xml.errorString()).arg(xml.lineNumber());
+        return false;
+    }
+    return true;
+}
+
+// ---- PBF ----------------------------------------------------------------
+
+// Reads the fields of one protobuf message in order
+class ProtoReader {
+public:
+    ProtoReader(const char* data, qint64 size)
+        : p(reinterpret_cast<const uchar*>(data)), end(p + size), bad(false), fieldNumber(0), wire(0) {}
+
+    bool next()
+    {
+        quint64 key;
+        if (p >= end || !readVarint(key)) {
+            return false;
+        }
+        fieldNumber = static_cast<int>(key >> 3);
+        wire = static_cast<int>(key & 7);
+        return true;
+    }
+
+    int field() const { return fieldNumber; }
+    bool failed() const { return bad; }
+
+    // False at the end of the data, or on a truncated value
+    bool readVarint(quint64& value)
+    {
+        value = 0;
+        if (p >= end) {
+            return false;
+        }
+        for (int shift = 0; shift < 64 && p < end; shift += 7) {
+            const uchar byte = *p++;
+            value |= static_cast<quint64>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        bad = true;
+        p = end;
+        return false;
+    }
+
+    quint64 varint()
+    {
+        quint64 value = 0;
+        readVarint(value);
+        return value;
+    }
+
+    qint64 svarint()
+    {
+        const quint64 value = varint();
+        return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+    }
+
+    // Length-delimited payload as a nested reader
+    ProtoReader bytes()
+    {
+        const quint64 size = varint();
+        if (size > static_cast<quint64>(end - p)) {
+            bad = true;
+            return ProtoReader(nullptr, 0);
+        }
+        ProtoReader nested(reinterpret_cast<const char*>(p), static_cast<qint64>(size));
+        p += size;
+        return nested;
+    }
+
+    QByteArray byteArray()
+    {
+        ProtoReader nested = bytes();
+        return QByteArray(reinterpret_cast<const char*>(nested.p), static_cast<int>(nested.end - nested.p));
+    }
+
+    void skip()
+    {
+        switch (wire) {
+        case 0: varint(); break;
+        case 1: advance(8); break;
+        case 2: bytes(); break;
+        case 5: advance(4); break;
+        default: bad = true; p = end; break;
+        }
+    }
+
+private:
+    void advance(qint64 count)
+    {
+        if (count > end - p) {
+            bad = true;
+            p = end;
+        } else {
+            p += count;
+        }
+    }
+
+    const uchar* p;
+    const uchar* end;
+    bool bad;
+    int fieldNumber;
+    int wire;
+};
+
+struct BlockOutput {
+    std::vector<ParsedWay> ways;
+    std::vector<Place> places;
+    QString error;
+};
+
+// Blob payload, decompressed
+bool unpackBlob(const QByteArray& blob, QByteArray& data, QString& error)
+{
+    ProtoReader reader(blob.constData(), blob.size());
+    QByteArray zlibData;
+    quint32 rawSize = 0;
+
+    while (reader.next()) {
+        switch (reader.field()) {
+        case 1: data = reader.byteArray(); return true;
+        case 2: rawSize = static_cast<quint32>(reader.varint()); break;
+        case 3: zlibData = reader.byteArray(); break;
+        case 4: case 6: case 7: case 8:
+            error = "Unsupported PBF compression (only raw and zlib blocks are read)";
+            return false;
+        default: reader.skip(); break;
+        }
+    }
+
+    // qUncompress expects the uncompressed size as a big-endian prefix
+    QByteArray prefixed(4, '\0');
+    prefixed[0] = static_cast<char>((rawSize >> 24) & 0xff);
+    prefixed[1] = static_cast<char>((rawSize >> 16) & 0xff);
+    prefixed[2] = static_cast<char>((rawSize >> 8) & 0xff);
+    prefixed[3] = static_cast<char>(rawSize & 0xff);
+    prefixed += zlibData;
+
+    data = qUncompress(prefixed);
+    if (data.size() != static_cast<int>(rawSize) || reader.failed()) {
+        error = "Corrupt PBF block";
+        return false;
+    }
+    return true;
+}
+
+void decodeWay(ProtoReader reader, const std::vector<QString>& strings, BlockOutput& out)
+{
+    std::vector<quint32> keys;
+    std::vector<quint32> vals;
+    ParsedWay way;
+
+    while (reader.next()) {
+        if (reader.field() == 2 || reader.field() == 3) {
+            ProtoReader packed = reader.bytes();
+            quint64 value;
+            while (packed.readVarint(value)) {
+                (reader.field() == 2 ? keys : vals).push_back(static_cast<quint32>(value));
+            }
+        } else if (reader.field() == 8) {
+            ProtoReader packed = reader.bytes();
+            qint64 ref = 0;
+            quint64 value;
+            while (packed.readVarint(value)) {
+                ref += static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+                way.refs.push_back(ref);
+            }
+        } else {
+            reader.skip();
+        }
+    }
+
+    Tags tags;
+    for (size_t i = 0; i < keys.size() && i < vals.size(); i++) {
+        if (keys[i] < strings.size() && vals[i] < strings.size()) {
+            tags.push_back({strings[keys[i]], strings[vals[i]]});
+        }
+    }
+    if (parseWayTags(tags, way)) {
+        out.ways.push_back(std::move(way));
+    }
+}
+
+struct BlockFrame {
+    std::vector<QString> strings;
+    qint64 granularity = 100;
+    qint64 latOffset = 0;
+    qint64 lonOffset = 0;
+
+    double lat(qint64 value) const { return 1e-9 * (latOffset + granularity * value); }
+    double lon(qint64 value) const { return 1e-9 * (lonOffset + granularity * value); }
+};
+
+void decodeDenseNodes(ProtoReader reader, const BlockFrame& frame, Collector& collector,
+                      BlockOutput& out)
+{
+    ProtoReader ids(nullptr, 0), lats(nullptr, 0), lons(nullptr, 0), keysVals(nullptr, 0);
+    while (reader.next()) {
+        switch (reader.field()) {
+        case 1: ids = reader.bytes(); break;
+        case 8: lats = reader.bytes(); break;
+        case 9: lons = reader.bytes(); break;
+        case 10: keysVals = reader.bytes(); break;
+        default: reader.skip(); break;
+        }
+    }
+
+    qint64 id = 0, lat = 0, lon = 0;
+    quint64 value;
+    while (ids.readVarint(value)) {
+        id += static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+        lat += lats.svarint();
+        lon += lons.svarint();
+        collector.locate(id, frame.lat(lat), frame.lon(lon));
+
+        // Tags are key/value string indices, each node's list ending in 0
+        Tags tags;
+        quint64 key;
+        while (keysVals.readVarint(key) && key != 0) {
+            const quint64 val = keysVals.varint();
+            if (key < frame.strings.size() && val < frame.strings.size()) {
+                tags.push_back({frame.strings[key], frame.strings[val]});
+            }
+        }
+        Place place;
+        if (!tags.empty() && placeFromTags(tags, frame.lat(lat), frame.lon(lon), place)) {
+            out.places.push_back(place);
+        }
+    }
+}
+
+void decodeNode(ProtoReader reader, const BlockFrame& frame, Collector& collector, BlockOutput& out)
+{
+    qint64 id = 0, lat = 0, lon = 0;
+    std::vector<quint32> keys;
+    std::vector<quint32> vals;
+
+    while (reader.next()) {
+        switch (reader.field()) {
+        case 1: id = reader.svarint(); break;
+        case 8: lat = reader.svarint(); break;
+        case 9: lon = reader.svarint(); break;
+        case 2: case 3: {
+            ProtoReader packed = reader.bytes();
+            quint64 value;
+            while (packed.readVarint(value)) {
+                (reader.field() == 2 ? keys : vals).push_back(static_cast<quint32>(value));
+            }
+            break;
+        }
+        default: reader.skip(); break;
+        }
+    }
+
+    collector.locate(id, frame.lat(lat), frame.lon(lon));
+
+    Tags tags;
+    for (size_t i = 0; i < keys.size() && i < vals.size(); i++) {
+        if (keys[i] < frame.strings.size() && vals[i] < frame.strings.size()) {
+            tags.push_back({frame.strings[keys[i]], frame.strings[vals[i]]});
+        }
+    }
+    Place place;
+    if (placeFromTags(tags, frame.lat(lat), frame.lon(lon), place)) {
+        out.places.push_back(place);
+    }
+}
+
+// Decodes one OSMData blob. The first pass only looks at ways, the second
+// only at nodes, skipping the other kind without decoding it.
+void decodeBlock(const QByteArray& blob, int pass, Collector& collector, BlockOutput& out)
+{
+    QByteArray data;
+    if (!unpackBlob(blob, data, out.error)) {
+        return;
+    }
+
+    BlockFrame frame;
+    std::vector<ProtoReader> groups;
+    ProtoReader block(data.constData(), data.size());
+    while (block.next()) {
+        switch (block.field()) {
+        case 1: {
+            ProtoReader table = block.bytes();
+            while (table.next()) {
+                if (table.field() == 1) {
+                    frame.strings.push_back(QString::fromUtf8(table.byteArray()));
+                } else {
+                    table.skip();
+                }
+            }
+            break;
+        }
+        case 2: groups.push_back(block.bytes()); break;
+        case 17: frame.granularity = static_cast<qint64>(block.varint()); break;
+        case 19: frame.latOffset = static_cast<qint64>(block.varint()); break;
+        case 20: frame.lonOffset = static_cast<qint64>(block.varint()); break;
+        default: block.skip(); break;
+        }
+    }
+
+    for (ProtoReader& group : groups) {
+        while (group.next()) {
+            if (pass == 1 && group.field() == 3) {
+                decodeWay(group.bytes(), frame.strings, out);
+            } else if (pass == 2 && group.field() == 1) {
+                decodeNode(group.bytes(), frame, collector, out);
+            } else if (pass == 2 && group.field() == 2) {
+                decodeDenseNodes(group.bytes(), frame, collector, out);
+            } else {
+                group.skip();
+            }
+        }
+        if (group.failed()) {
+            out.error = "Corrupt PBF primitive group";
+        }
+    }
+}
+
+bool checkHeader(const QByteArray& blob, QString& error)
+{
+    QByteArray data;
+    if (!unpackBlob(blob, data, error)) {
+        return false;
+    }
+    ProtoReader header(data.constData(), data.size());
+    while (header.next()) {
+        if (header.field() == 4) {
+            const QByteArray feature = header.byteArray();
+            if (feature != "OsmSchema-V0.6" && feature != "DenseNodes") {
+                error = QString("Unsupported PBF feature %1").arg(QString::fromUtf8(feature));
+                return false;
+            }
+        } else {
+            header.skip();
+        }
+    }
+    return true;
+}
+
+// Next blob of the file; false at the end or on error
+bool readBlob(QFile& file, QByteArray& type, QByteArray& blob, QString& error)
+{
+    const QByteArray sizeBytes = file.read(4);
+    if (sizeBytes.size() < 4) {
+        return false;
+    }
+    const quint32 headerSize = (static_cast<quint32>(static_cast<uchar>(sizeBytes[0])) << 24) |
+                               (static_cast<quint32>(static_cast<uchar>(sizeBytes[1])) << 16) |
+                               (static_cast<quint32>(static_cast<uchar>(sizeBytes[2])) << 8) |
+                               static_cast<quint32>(static_cast<uchar>(sizeBytes[3]));
+    if (headerSize > static_cast<quint32>(MaxBlobHeaderSize)) {
+        error = "Corrupt PBF blob header";
+        return false;
+    }
+
+    const QByteArray headerData = file.read(headerSize);
+    ProtoReader header(headerData.constData(), headerData.size());
+    qint64 dataSize = -1;
+    while (header.next()) {
+        if (header.field() == 1) {
+            type = header.byteArray();
+        } else if (header.field() == 3) {
+            dataSize = static_cast<qint64>(header.varint());
+        } else {
+            header.skip();
+        }
+    }
+    if (header.failed() || dataSize < 0 || dataSize > MaxBlobSize) {
+        error = "Corrupt PBF blob header";
+        return false;
+    }
+
+    blob = file.read(dataSize);
+    if (blob.size() != dataSize) {
+        error = "Truncated PBF file";
+        return false;
+    }
+    return true;
+}
+
+bool readPbf(const QString& path, int pass, Collector& collector, QString& error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    // A few blocks per thread are in memory at any time
+    const int batchSize = std::max(1, QThread::idealThreadCount()) * 2;
+
+    bool done = false;
+    while (!done) {
+        std::vector<QByteArray> batch;
+        while (static_cast<int>(batch.size()) < batchSize) {
+            QByteArray type, blob;
+            if (!readBlob(file, type, blob, error)) {
+                done = true;
+                break;
+            }
+            if (type == "OSMHeader") {
+                if (pass == 1 && !checkHeader(blob, error)) {
+                    return false;
+                }
+            } else if (type == "OSMData") {
+                batch.push_back(blob);
+            }
+        }
+        if (!error.isEmpty()) {
+            return false;
+        }
+
+        std::vector<BlockOutput> outputs(batch.size());
+        std::vector<int> indices(batch.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        QtConcurrent::blockingMap(indices, [&](int i) {
+            decodeBlock(batch[i], pass, collector, outputs[i]);
+        });
+
+        // Merge in file order so the result does not depend on scheduling
+        for (BlockOutput& out : outputs) {
+            if (!out.error.isEmpty()) {
+                error = out.error;
+                return false;
+            }
+            for (ParsedWay& way : out.ways) {
+                collector.addWay(way);
+            }
+            collector.places.insert(collector.places.end(), out.places.begin(), out.places.end());
+        }
+    }
+    return true;
+}
+
+// Calls visit(fromIndex, toIndex, length) for each stretch of a way between
+// graph nodes. A missing node coordinate splits the way. A stretch that
+// comes back to the node it left, such as a closed way joined to the rest
+// at one node only, is split at its point farthest from that node, which
+// becomes a graph node too.
+template <typename Visit>
+void walkWay(const Collector& collector, const Collector::WayInfo& way, Visit visit)
+{
+    auto coord = [&collector](int i) { return GeoCoord(collector.lats[i], collector.lons[i]); };
+
+    int from = -1;
+    int fromRef = -1;
+    int previous = -1;
+    double length = 0.0;
+
+    for (int k = 0; k < way.refCount; k++) {
+        const int i = collector.refIndex[way.firstRef + k];
+        if (!collector.located[i]) {
+            from = -1;
+            continue;
+        }
+        if (from < 0) {
+            from = previous = i;
+            fromRef = k;
+            length = 0.0;
+            continue;
+        }
+
+        length += coord(previous).distanceTo(coord(i));
+        previous = i;
+
+        const bool last = k + 1 == way.refCount ||
+                          !collector.located[collector.refIndex[way.firstRef + k + 1]];
+        if (collector.uses[i] >= 2 || last) {
+            if (i != from) {
+                visit(from, i, length);
+            } else if (k - fromRef >= 2) {
+                int middle = -1;
+                double farthest = -1.0;
+                double toMiddle = 0.0;
+                double along = 0.0;
+                for (int j = fromRef + 1; j < k; j++) {
+                    const int m = collector.refIndex[way.firstRef + j];
+                    along += coord(collector.refIndex[way.firstRef + j - 1]).distanceTo(coord(m));
+                    const double distance = coord(from).distanceTo(coord(m));
+                    if (distance > farthest) {
+                        middle = m;
+                        farthest = distance;
+                        toMiddle = along;
+                    }
+                }
+                visit(from, middle, toMiddle);
+                visit(middle, i, length - toMiddle);
+            }
+            from = i;
+            fromRef = k;
+            length = 0.0;
+        }
+    }
+}
+
+} // namespace
+
+OsmImporter::OsmImporter()
+    : places(0)
+{
+}
+
+double OsmImporter::defaultSpeed(const QString& highway)
+{
+    static const std::pair<const char*, double> speeds[] = {
+        {"motorway", 110.0}, {"motorway_link", 60.0},
+        {"trunk", 90.0}, {"trunk_link", 50.0},
+        {"primary", 70.0}, {"primary_link", 40.0},
+        {"secondary", 60.0}, {"secondary_link", 40.0},
+        {"tertiary", 50.0}, {"tertiary_link", 30.0},
+        {"unclassified", 40.0}, {"road", 40.0},
+        {"residential", 30.0}, {"living_street", 10.0}, {"service", 20.0}
+    };
+    for (const auto& entry : speeds) {
+        if (highway == QLatin1String(entry.first)) {
+            return entry.second;
+        }
+    }
+    return 0.0;
+}
+
+RoadClass OsmImporter::roadClass(const QString& highway)
+{
+    if (highway.startsWith("motorway")) return RoadClass::Motorway;
+    if (highway.startsWith("trunk")) return RoadClass::Trunk;
+    if (highway.startsWith("primary")) return RoadClass::Primary;
+    if (highway.startsWith("secondary")) return RoadClass::Secondary;
+    if (highway.startsWith("tertiary")) return RoadClass::Tertiary;
+    if (highway == QLatin1String("service")) return RoadClass::Service;
+    return RoadClass::Local;
+}
+
+double OsmImporter::parseMaxSpeed(const QString& value, double fallback)
+{
+    const QString text = value.trimmed();
+    if (text == QLatin1String("walk")) {
+        return 5.0;
+    }
+
+    int digits = 0;
+    while (digits < text.size() && (text[digits].isDigit() || text[digits] == QLatin1Char('.'))) {
+        digits++;
+    }
+    bool ok = false;
+    double speed = text.left(digits).toDouble(&ok);
+    if (!ok || speed <= 0.0) {
+        return fallback;
+    }
+    if (text.mid(digits).trimmed() == QLatin1String("mph")) {
+        speed *= 1.609344;
+    }
+    return speed;
+}
+
+bool OsmImporter::load(const QString& path)
+{
+    roadGraph = RoadGraph();
+    error.clear();
+    places = 0;
+
+    const bool pbf = QFileInfo(path).fileName().endsWith(".pbf", Qt::CaseInsensitive);
+    auto readPass = [&](int pass, Collector& collector) {
+        return pbf ? readPbf(path, pass, collector, error) : readXml(path, pass, collector, error);
+    };
+
+    Collector collector;
+    if (!readPass(1, collector)) {
+        return false;
+    }
+    collector.finishWays();
+    if (!readPass(2, collector)) {
+        return false;
+    }
+
+    // Graph ids in order of first use along the ways
+    std::vector<int> graphIds(collector.nodeIds.size(), -1);
+    std::vector<int> graphNodes;
+    auto graphId = [&](int i) {
+        if (graphIds[i] < 0) {
+            graphIds[i] = static_cast<int>(graphNodes.size());
+            graphNodes.push_back(i);
+        }
+        return graphIds[i];
+    };
+    for (const auto& way : collector.ways) {
+        walkWay(collector, way, [&](int from, int to, double) {
+            graphId(from);
+            graphId(to);
+        });
+    }
+
+    // Name graph nodes after the nearest places, more important ones first
+    std::vector<QString> nodeNames(graphNodes.size());
+    std::unordered_map<quint64, std::vector<int>> grid;
+    auto cellKey = [](long long row, long long column) {
+        return (static_cast<quint64>(row) << 32) ^ static_cast<quint64>(column & 0xffffffff);
+    };
+    for (int id = 0; id < static_cast<int>(graphNodes.size()); id++) {
+        const int i = graphNodes[id];
+        grid[cellKey(static_cast<long long>(std::floor(collector.lats[i] / SnapCell)),
+                     static_cast<long long>(std::floor(collector.lons[i] / SnapCell)))].push_back(id);
+    }
+
+    std::stable_sort(collector.places.begin(), collector.places.end(),
+                     [](const Place& a, const Place& b) { return a.rank < b.rank; });
+    for (const Place& place : collector.places) {
+        const long long row = static_cast<long long>(std::floor(place.lat / SnapCell));
+        const long long column = static_cast<long long>(std::floor(place.lon / SnapCell));
+        const GeoCoord at(place.lat, place.lon);
+
+        int best = -1;
+        double bestDistance = MaxPlaceSnap;
+        for (long long dr = -1; dr <= 1; dr++) {
+            for (long long dc = -1; dc <= 1; dc++) {
+                auto cell = grid.find(cellKey(row + dr, column + dc));
+                if (cell == grid.end()) {
+                    continue;
+                }
+                for (int id : cell->second) {
+                    const int i = graphNodes[id];
+                    const double d = at.distanceTo(GeoCoord(collector.lats[i], collector.lons[i]));
+                    if (nodeNames[id].isEmpty() && d < bestDistance) {
+                        best = id;
+                        bestDistance = d;
+                    }
+                }
+            }
+        }
+        if (best >= 0) {
+            nodeNames[best] = place.name;
+            places++;
+        }
+    }
+
+    RoadGraphBuilder builder;
+    for (size_t id = 0; id < graphNodes.size(); id++) {
+        const int i = graphNodes[id];
+        builder.addNode(collector.lats[i], collector.lons[i], nodeNames[id]);
+    }
+    for (const auto& way : collector.ways) {
+        const QString& name = collector.names[way.nameId];
+        walkWay(collector, way, [&](int from, int to, double length) {
+            Edge edge(graphIds[to], length, way.speed, name);
+            edge.roadClass = way.roadClass;
+            if (way.oneway >= 0) {
+                builder.addEdge(graphIds[from], edge);
+            }
+            if (way.oneway <= 0) {
+                edge.toNode = graphIds[from];
+                builder.addEdge(graphIds[to], edge);
+            }
+        });
+    }
+
+    roadGraph = builder.build(NodeOrder::Hilbert);
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef OSMIMPORTER_H
+#define OSMIMPORTER_H
+
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+#include "roadgraph.h"
+
+// Streams an OpenStreetMap extract, XML (.osm) or PBF (.osm.pbf), into a
+// RoadGraph for car routing.
+//
+// The file is read twice. The first pass keeps only drivable highway ways
+// and the node ids they reference; the second keeps the coordinates of
+// those nodes and any named places. Nodes shared by several ways or ending
+// one become graph nodes; the others only shape the edge lengths. Memory
+// therefore grows with the road network, not with the extract. PBF blocks
+// are decompressed and decoded on the global thread pool.
+class OsmImporter {
+public:
+    OsmImporter();
+
+    // Returns false and sets errorString() when the file cannot be read
+    bool load(const QString& path);
+
+    const RoadGraph& graph() const { return roadGraph; }
+    QString errorString() const { return error; }
+    int placeCount() const { return places; }
+
+    // Free-flow speed in km/h for a highway=* value, or 0 when cars do not
+    // use that kind of way
+    static double defaultSpeed(const QString& highway);
+    // Functional class for a highway=* value that defaultSpeed() accepts
+    static RoadClass roadClass(const QString& highway);
+    // Value of a maxspeed=* tag in km/h, or fallback when it gives no number
+    static double parseMaxSpeed(const QString& value, double fallback);
+
+private:
+    RoadGraph roadGraph;
+    QString error;
+    int places;
+};
+
+#endif // OSMIMPORTER_H
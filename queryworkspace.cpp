@@ -0,0 +1,111 @@
+#include "queryworkspace.h"
+#include <algorithm>
+
+namespace {
+
+const int WorkspaceSlots = 2;
+
+} // namespace
+
+QueryWorkspace::QueryWorkspace()
+    : generation(0),
+    heapKind(HeapKind::Binary)
+{
+}
+
+void QueryWorkspace::startQuery(int nodeCount, HeapKind kind)
+{
+    clearQueue();
+    heapKind = kind;
+    if (kind == HeapKind::FourAry) {
+        indexedHeap.reserve(nodeCount);
+    }
+
+    if (static_cast<int>(stamps.size()) < nodeCount) {
+        distances.resize(nodeCount);
+        parents.resize(nodeCount);
+        parentEdges.resize(nodeCount);
+        stamps.resize(nodeCount, 0);
+    }
+
+    // Stamp 0 never marks a live entry; on wrap-around wipe the old stamps
+    if (++generation == 0) {
+        std::fill(stamps.begin(), stamps.end(), 0);
+        generation = 1;
+    }
+}
+
+bool QueryWorkspace::empty() const
+{
+    switch (heapKind) {
+    case HeapKind::FourAry:
+        return indexedHeap.empty();
+    case HeapKind::Radix:
+        return radixHeap.empty();
+    default:
+        return binaryHeap.empty();
+    }
+}
+
+const QueryWorkspace::HeapEntry& QueryWorkspace::top()
+{
+    switch (heapKind) {
+    case HeapKind::FourAry:
+        return indexedHeap.top();
+    case HeapKind::Radix:
+        return radixHeap.top();
+    default:
+        return binaryHeap.top();
+    }
+}
+
+void QueryWorkspace::push(int node, double cost, double key)
+{
+    switch (heapKind) {
+    case HeapKind::FourAry:
+        indexedHeap.push({key, cost, node});
+        break;
+    case HeapKind::Radix:
+        radixHeap.push({key, cost, node});
+        break;
+    default:
+        binaryHeap.push({key, cost, node});
+        break;
+    }
+}
+
+void QueryWorkspace::pop()
+{
+    switch (heapKind) {
+    case HeapKind::FourAry:
+        indexedHeap.pop();
+        break;
+    case HeapKind::Radix:
+        radixHeap.pop();
+        break;
+    default:
+        binaryHeap.pop();
+        break;
+    }
+}
+
+void QueryWorkspace::clearQueue()
+{
+    switch (heapKind) {
+    case HeapKind::FourAry:
+        indexedHeap.clear();
+        break;
+    case HeapKind::Radix:
+        radixHeap.clear();
+        break;
+    default:
+        binaryHeap.clear();
+        break;
+    }
+}
+
+QueryWorkspace& QueryWorkspace::local(int slot)
+{
+    thread_local QueryWorkspace workspaces[WorkspaceSlots];
+    return workspaces[slot];
+}
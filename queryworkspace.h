@@ -0,0 +1,65 @@
+#ifndef QUERYWORKSPACE_H
+#define QUERYWORKSPACE_H
+
+#include <QtGlobal>
+#include <vector>
+#include <limits>
+#include "heaps.h"
+
+// Scratch state for one shortest path search: tentative distances, parents
+// and the priority queue, all indexed densely by node id. The queue is one
+// of the heaps in heaps.h, chosen per query.
+//
+// Each entry carries the generation it was written in, and only entries of
+// the current generation count as reached. Starting a query therefore just
+// bumps the generation instead of clearing O(nodeCount) memory, and the
+// arrays and heap storage are reused from one query to the next.
+class QueryWorkspace {
+public:
+    using HeapEntry = QueueEntry;
+
+    QueryWorkspace();
+
+    void startQuery(int nodeCount, HeapKind kind = HeapKind::Binary);
+
+    bool isReached(int node) const { return stamps[node] == generation; }
+    double distance(int node) const {
+        return isReached(node) ? distances[node] : std::numeric_limits<double>::infinity();
+    }
+    // Only meaningful for reached nodes; -1 at the search origin
+    int parent(int node) const { return parents[node]; }
+    int parentEdge(int node) const { return parentEdges[node]; }
+
+    void setDistance(int node, double dist, int parentNode = -1, int edge = -1) {
+        stamps[node] = generation;
+        distances[node] = dist;
+        parents[node] = parentNode;
+        parentEdges[node] = edge;
+    }
+
+    // With the binary and radix heaps a node may be queued more than once,
+    // so searches still skip entries whose cost is above the distance
+    bool empty() const;
+    const HeapEntry& top();
+    void push(int node, double cost, double key);
+    void pop();
+    void clearQueue();
+
+    // The calling thread's workspace. A query that runs several searches at
+    // once, such as forward and backward, uses one slot for each.
+    static QueryWorkspace& local(int slot = 0);
+
+private:
+    std::vector<double> distances;
+    std::vector<int> parents;
+    std::vector<int> parentEdges;
+    std::vector<quint32> stamps;
+    quint32 generation;
+
+    HeapKind heapKind;
+    BinaryHeap binaryHeap;
+    IndexedHeap indexedHeap;
+    RadixHeap radixHeap;
+};
+
+#endif // QUERYWORKSPACE_H
@@ -0,0 +1,533 @@
+#include "roadgraph.h"
+#include <QFile>
+#include <QSaveFile>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+namespace {
+
+// Column order in sections() and in the file
+enum SectionId {
+    CoordsSection,
+    NodeNamesSection,
+    ExternalIdsSection,
+    InternalIdsSection,
+    FirstEdgeSection,
+    EdgeTargetsSection,
+    EdgeLengthsSection,
+    EdgeTimesSection,
+    EdgeClassesSection,
+    EdgeNamesSection,
+    NameOffsetsSection,
+    NameBytesSection,
+    ReverseFirstSection,
+    ReverseSourcesSection,
+    ReverseEdgesSection,
+    KeyOffsetsSection,
+    KeyBytesSection,
+    KeyNodesSection,
+    MaxSpeedSection,
+    SectionCount
+};
+
+const quint32 FileMagic = 0x48505247; // "GRPH"
+const quint32 FileVersion = 3;
+// Sections start on cache-line boundaries, which also aligns every column
+const quint64 SectionAlignment = 64;
+
+// All fields little-endian. The header checksum covers the header, with
+// that field zeroed, and the section table; the payload checksum covers
+// everything after the table, padding included.
+struct FileHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 sectionCount;
+    quint32 reserved;
+    quint64 fileSize;
+    quint64 payloadChecksum;
+    quint64 headerChecksum;
+};
+
+struct SectionEntry {
+    quint64 offset;
+    quint64 count;
+    quint32 elementSize;
+    quint32 reserved;
+};
+
+quint64 alignUp(quint64 value)
+{
+    return (value + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+}
+
+// Word-at-a-time hash, cheap enough to run at memory bandwidth. A trailing
+// partial word is hashed as if padded with zeros.
+quint64 mixWords(quint64 hash, const void* data, quint64 size)
+{
+    const uchar* bytes = static_cast<const uchar*>(data);
+    for (quint64 i = 0; i < size; i += 8) {
+        quint64 word = 0;
+        std::memcpy(&word, bytes + i, std::min<quint64>(8, size - i));
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+quint64 mixZeros(quint64 hash, quint64 size)
+{
+    static const char zeros[SectionAlignment] = {};
+    for (; size > 0; size -= std::min(size, SectionAlignment)) {
+        hash = mixWords(hash, zeros, std::min(size, SectionAlignment));
+    }
+    return hash;
+}
+
+// Columns of a graph built in memory
+struct OwnedColumns {
+    std::vector<FixedCoord> coords;
+    std::vector<qint32> nodeNameIds;
+    std::vector<qint32> externalIds;
+    std::vector<qint32> internalIds;
+    std::vector<qint32> firstEdge;
+    std::vector<qint32> edgeTargets;
+    std::vector<quint32> edgeLengths;
+    std::vector<quint32> edgeTimes;
+    std::vector<quint8> edgeClasses;
+    std::vector<qint32> edgeNameIds;
+    std::vector<quint32> nameOffsets;
+    std::vector<char> nameBytes;
+    std::vector<qint32> reverseFirst;
+    std::vector<qint32> reverseSources;
+    std::vector<qint32> reverseEdges;
+    std::vector<quint32> keyOffsets;
+    std::vector<char> keyBytes;
+    std::vector<qint32> keyNodes;
+    double maxSpeed = 0.0;
+};
+
+// Keeps a graph file mapped for as long as any RoadGraph uses it
+struct MappedFile {
+    explicit MappedFile(const QString& path) : file(path), data(nullptr) {}
+    ~MappedFile() { if (data) file.unmap(data); }
+
+    QFile file;
+    uchar* data;
+};
+
+} // namespace
+
+RoadGraph::RoadGraph()
+    : fastest(0.0)
+{
+}
+
+std::vector<RoadGraph::Section> RoadGraph::sections() const
+{
+    std::vector<Section> list(SectionCount);
+    auto add = [&list](SectionId id, const auto& column) {
+        using T = typename std::decay_t<decltype(column)>::value_type;
+        list[id] = {column.data(), column.size(), static_cast<quint32>(sizeof(T))};
+    };
+
+    add(CoordsSection, coords);
+    add(NodeNamesSection, nodeNameIds);
+    add(ExternalIdsSection, externalIds);
+    add(InternalIdsSection, internalIds);
+    add(FirstEdgeSection, firstEdge);
+    add(EdgeTargetsSection, edgeTargets);
+    add(EdgeLengthsSection, edgeLengths);
+    add(EdgeTimesSection, edgeTimes);
+    add(EdgeClassesSection, edgeClasses);
+    add(EdgeNamesSection, edgeNameIds);
+    add(NameOffsetsSection, names.offsets);
+    add(NameBytesSection, names.bytes);
+    add(ReverseFirstSection, reverseEdges.firstEdge);
+    add(ReverseSourcesSection, reverseEdges.sources);
+    add(ReverseEdgesSection, reverseEdges.edgeIds);
+    add(KeyOffsetsSection, keys.offsets);
+    add(KeyBytesSection, keys.bytes);
+    add(KeyNodesSection, keyNodes);
+    add(MaxSpeedSection, ArrayView<double>(&fastest, 1));
+    return list;
+}
+
+void RoadGraph::setSections(const std::vector<Section>& list)
+{
+    auto take = [&list](SectionId id, auto& column) {
+        using T = typename std::decay_t<decltype(column)>::value_type;
+        column = ArrayView<T>(static_cast<const T*>(list[id].data), list[id].count);
+    };
+
+    take(CoordsSection, coords);
+    take(NodeNamesSection, nodeNameIds);
+    take(ExternalIdsSection, externalIds);
+    take(InternalIdsSection, internalIds);
+    take(FirstEdgeSection, firstEdge);
+    take(EdgeTargetsSection, edgeTargets);
+    take(EdgeLengthsSection, edgeLengths);
+    take(EdgeTimesSection, edgeTimes);
+    take(EdgeClassesSection, edgeClasses);
+    take(EdgeNamesSection, edgeNameIds);
+    take(NameOffsetsSection, names.offsets);
+    take(NameBytesSection, names.bytes);
+    take(ReverseFirstSection, reverseEdges.firstEdge);
+    take(ReverseSourcesSection, reverseEdges.sources);
+    take(ReverseEdgesSection, reverseEdges.edgeIds);
+    take(KeyOffsetsSection, keys.offsets);
+    take(KeyBytesSection, keys.bytes);
+    take(KeyNodesSection, keyNodes);
+    fastest = *static_cast<const double*>(list[MaxSpeedSection].data);
+}
+
+bool RoadGraph::save(const QString& path) const
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(path);
+    return false;
+#else
+    const std::vector<Section> list = sections();
+
+    FileHeader header = {};
+    header.magic = FileMagic;
+    header.version = FileVersion;
+    header.sectionCount = SectionCount;
+
+    std::vector<SectionEntry> table(SectionCount);
+    const quint64 payloadStart = alignUp(sizeof(FileHeader) + sizeof(SectionEntry) * table.size());
+    quint64 offset = payloadStart;
+    quint64 payloadChecksum = 0;
+    for (int i = 0; i < SectionCount; i++) {
+        const quint64 bytes = list[i].count * list[i].elementSize;
+        table[i] = {offset, list[i].count, list[i].elementSize, 0};
+        payloadChecksum = mixWords(payloadChecksum, list[i].data, bytes);
+        payloadChecksum = mixZeros(payloadChecksum, alignUp(bytes) - (bytes + 7) / 8 * 8);
+        offset += alignUp(bytes);
+    }
+    header.fileSize = offset;
+    header.payloadChecksum = payloadChecksum;
+    header.headerChecksum = mixWords(mixWords(0, &header, sizeof(header)),
+                                     table.data(), sizeof(SectionEntry) * table.size());
+
+    // Written aside and renamed into place, so a process that has the old
+    // file mapped keeps reading consistent data
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    static const char zeros[SectionAlignment] = {};
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+    const qint64 tableBytes = static_cast<qint64>(sizeof(SectionEntry) * table.size());
+    ok = ok && file.write(reinterpret_cast<const char*>(table.data()), tableBytes) == tableBytes;
+    ok = ok && file.write(zeros, payloadStart - sizeof(header) - tableBytes) >= 0;
+    for (int i = 0; i < SectionCount && ok; i++) {
+        const qint64 bytes = static_cast<qint64>(list[i].count * list[i].elementSize);
+        ok = file.write(static_cast<const char*>(list[i].data), bytes) == bytes &&
+             file.write(zeros, alignUp(bytes) - bytes) >= 0;
+    }
+
+    return ok && file.commit();
+#endif
+}
+
+bool RoadGraph::load(const QString& path, bool verifyChecksum)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(path);
+    Q_UNUSED(verifyChecksum);
+    return false;
+#else
+    auto mapped = std::make_shared<MappedFile>(path);
+    if (!mapped->file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const quint64 fileSize = static_cast<quint64>(mapped->file.size());
+    const quint64 payloadStart = alignUp(sizeof(FileHeader) + sizeof(SectionEntry) * SectionCount);
+    if (fileSize < payloadStart) {
+        return false;
+    }
+    mapped->data = mapped->file.map(0, static_cast<qint64>(fileSize));
+    if (!mapped->data) {
+        return false;
+    }
+
+    FileHeader header;
+    std::vector<SectionEntry> table(SectionCount);
+    std::memcpy(&header, mapped->data, sizeof(header));
+    if (header.magic != FileMagic || header.version != FileVersion ||
+        header.sectionCount != static_cast<quint32>(SectionCount) || header.fileSize != fileSize) {
+        return false;
+    }
+    std::memcpy(table.data(), mapped->data + sizeof(header), sizeof(SectionEntry) * table.size());
+
+    FileHeader unsummed = header;
+    unsummed.headerChecksum = 0;
+    if (mixWords(mixWords(0, &unsummed, sizeof(unsummed)), table.data(),
+                 sizeof(SectionEntry) * table.size()) != header.headerChecksum) {
+        return false;
+    }
+    if (verifyChecksum &&
+        mixWords(0, mapped->data + payloadStart, fileSize - payloadStart) != header.payloadChecksum) {
+        return false;
+    }
+
+    // Element sizes must match this build's columns, and every section must
+    // lie inside the file
+    const std::vector<Section> expected = RoadGraph().sections();
+    std::vector<Section> list(SectionCount);
+    for (int i = 0; i < SectionCount; i++) {
+        const SectionEntry& entry = table[i];
+        if (entry.elementSize != expected[i].elementSize || entry.offset < payloadStart ||
+            entry.offset % SectionAlignment != 0 || entry.offset > fileSize ||
+            entry.count > (fileSize - entry.offset) / entry.elementSize) {
+            return false;
+        }
+        list[i] = {mapped->data + entry.offset, entry.count, entry.elementSize};
+    }
+
+    // Column lengths must agree before the columns themselves are checked
+    const quint64 nodes = list[CoordsSection].count;
+    const quint64 edges = list[EdgeTargetsSection].count;
+    const quint64 maxCount = std::numeric_limits<qint32>::max();
+    if (nodes >= maxCount || edges >= maxCount ||
+        list[NodeNamesSection].count != nodes ||
+        list[ExternalIdsSection].count != nodes || list[InternalIdsSection].count != nodes ||
+        list[FirstEdgeSection].count != nodes + 1 || list[ReverseFirstSection].count != nodes + 1 ||
+        list[EdgeLengthsSection].count != edges || list[EdgeTimesSection].count != edges ||
+        list[EdgeClassesSection].count != edges ||
+        list[EdgeNamesSection].count != edges ||
+        list[ReverseSourcesSection].count != edges || list[ReverseEdgesSection].count != edges ||
+        list[NameOffsetsSection].count < 2 || list[KeyOffsetsSection].count < 1 ||
+        list[KeyNodesSection].count + 1 != list[KeyOffsetsSection].count ||
+        list[MaxSpeedSection].count != 1) {
+        return false;
+    }
+
+    RoadGraph loaded;
+    loaded.setSections(list);
+    if (!loaded.hasValidStructure()) {
+        return false;
+    }
+
+    loaded.storage = mapped;
+    *this = loaded;
+    return true;
+#endif
+}
+
+bool RoadGraph::hasValidStructure() const
+{
+    // One linear pass over the index columns; weights, coordinates and
+    // name bytes can hold any value without breaking an accessor
+    const qint64 nodes = nodeCount();
+    const qint64 edges = edgeCount();
+    return isOffsetColumn(firstEdge, edges) &&
+           isOffsetColumn(reverseEdges.firstEdge, edges) &&
+           isOffsetColumn(names.offsets, names.bytes.size()) &&
+           isOffsetColumn(keys.offsets, keys.bytes.size()) &&
+           isInRange(edgeTargets, 0, nodes) &&
+           isInRange(reverseEdges.sources, 0, nodes) &&
+           isInRange(reverseEdges.edgeIds, 0, edges) &&
+           isInRange(externalIds, 0, nodes) &&
+           isInRange(internalIds, -1, nodes) &&
+           isInRange(keyNodes, 0, nodes) &&
+           isInRange(nodeNameIds, 0, names.size()) &&
+           isInRange(edgeNameIds, 0, names.size()) &&
+           isInRange(edgeClasses, 0, static_cast<int>(RoadClass::Service) + 1);
+}
+
+int RoadGraphBuilder::addNode(double lat, double lon, const QString& name)
+{
+    int id = static_cast<int>(nodes.size());
+    nodes.push_back(Node(id, lat, lon, name));
+    return id;
+}
+
+void RoadGraphBuilder::addEdge(int fromNode, const Edge& edge)
+{
+    edgeSources.push_back(fromNode);
+    edges.push_back(edge);
+}
+
+void RoadGraphBuilder::addRoad(int nodeA, int nodeB, double speed, const QString& roadName)
+{
+    double dist = nodes[nodeA].coord.distanceTo(nodes[nodeB].coord);
+    addEdge(nodeA, Edge(nodeB, dist, speed, roadName));
+    addEdge(nodeB, Edge(nodeA, dist, speed, roadName));
+}
+
+RoadGraph RoadGraphBuilder::build(NodeOrder order) const
+{
+    auto columns = std::make_shared<OwnedColumns>();
+    OwnedColumns& c = *columns;
+
+    const int nodeCount = static_cast<int>(nodes.size());
+
+    // Interned names; id 0 is the empty string
+    std::unordered_map<QString, int> nameIds;
+    c.nameOffsets.assign(2, 0);
+    auto internName = [&](const QString& name) {
+        if (name.isEmpty()) {
+            return 0;
+        }
+        auto it = nameIds.find(name);
+        if (it == nameIds.end()) {
+            const QByteArray utf8 = name.toUtf8();
+            c.nameBytes.insert(c.nameBytes.end(), utf8.constData(), utf8.constData() + utf8.size());
+            c.nameOffsets.push_back(static_cast<quint32>(c.nameBytes.size()));
+            it = nameIds.emplace(name, static_cast<int>(c.nameOffsets.size()) - 2).first;
+        }
+        return it->second;
+    };
+
+    auto validEdge = [&](size_t i) {
+        return edgeSources[i] >= 0 && edgeSources[i] < nodeCount &&
+               edges[i].toNode >= 0 && edges[i].toNode < nodeCount;
+    };
+
+    // Undirected neighbours, which the traversal orders follow
+    std::vector<GeoCoord> coords;
+    coords.reserve(nodeCount);
+    for (const Node& node : nodes) {
+        coords.push_back(node.coord);
+    }
+    std::vector<int> neighbourFirst(nodeCount + 1, 0);
+    std::vector<int> neighbours;
+    if (order == NodeOrder::BreadthFirst || order == NodeOrder::DepthFirst) {
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (validEdge(i)) {
+                neighbourFirst[edgeSources[i] + 1]++;
+                neighbourFirst[edges[i].toNode + 1]++;
+            }
+        }
+        for (int u = 0; u < nodeCount; u++) {
+            neighbourFirst[u + 1] += neighbourFirst[u];
+        }
+        neighbours.resize(neighbourFirst[nodeCount]);
+        std::vector<int> next(neighbourFirst.begin(), neighbourFirst.end() - 1);
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (validEdge(i)) {
+                neighbours[next[edgeSources[i]]++] = edges[i].toNode;
+                neighbours[next[edges[i].toNode]++] = edgeSources[i];
+            }
+        }
+    }
+
+    // internalIds[external] is the new id; every later column uses new ids
+    c.internalIds = computeNodeOrder(order, coords, neighbourFirst, neighbours);
+    c.externalIds.resize(nodeCount);
+    for (int u = 0; u < nodeCount; u++) {
+        c.externalIds[c.internalIds[u]] = u;
+    }
+    const std::vector<qint32>& newId = c.internalIds;
+
+    c.coords.reserve(nodeCount);
+    c.nodeNameIds.reserve(nodeCount);
+    for (int u = 0; u < nodeCount; u++) {
+        const Node& node = nodes[c.externalIds[u]];
+        c.coords.push_back(FixedCoord::fromGeo(node.coord));
+        c.nodeNameIds.push_back(internName(node.name));
+    }
+
+    // Count edges per source node, then turn the counts into offsets
+    c.firstEdge.assign(nodeCount + 1, 0);
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (validEdge(i)) {
+            c.firstEdge[newId[edgeSources[i]] + 1]++;
+        }
+    }
+    for (int u = 0; u < nodeCount; u++) {
+        c.firstEdge[u + 1] += c.firstEdge[u];
+    }
+
+    const int edgeCount = c.firstEdge[nodeCount];
+    c.edgeTargets.resize(edgeCount);
+    c.edgeLengths.resize(edgeCount);
+    c.edgeTimes.resize(edgeCount);
+    c.edgeClasses.resize(edgeCount);
+    c.edgeNameIds.resize(edgeCount);
+
+    // Stable placement keeps each node's edges in insertion order
+    std::vector<int> cursor(c.firstEdge.begin(), c.firstEdge.end() - 1);
+
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (!validEdge(i)) {
+            continue;
+        }
+        const Edge& edge = edges[i];
+
+        int slot = cursor[newId[edgeSources[i]]]++;
+        c.edgeTargets[slot] = newId[edge.toNode];
+        c.edgeLengths[slot] = toDecimetres(edge.distance);
+        c.edgeTimes[slot] = std::max<quint32>(1, toDeciseconds(edge.travelTime()));
+        c.edgeClasses[slot] = static_cast<quint8>(edge.roadClass);
+        c.edgeNameIds[slot] = internName(edge.roadName);
+
+        // From the stored values, so the A* bound holds for rounded weights
+        c.maxSpeed = std::max(c.maxSpeed, static_cast<double>(c.edgeLengths[slot]) / c.edgeTimes[slot]);
+    }
+
+    // Incoming edges, grouped by head node
+    c.reverseFirst.assign(nodeCount + 1, 0);
+    for (int e = 0; e < edgeCount; e++) {
+        c.reverseFirst[c.edgeTargets[e] + 1]++;
+    }
+    for (int v = 0; v < nodeCount; v++) {
+        c.reverseFirst[v + 1] += c.reverseFirst[v];
+    }
+    c.reverseSources.resize(edgeCount);
+    c.reverseEdges.resize(edgeCount);
+    cursor.assign(c.reverseFirst.begin(), c.reverseFirst.end() - 1);
+    for (int u = 0; u < nodeCount; u++) {
+        for (int e = c.firstEdge[u]; e < c.firstEdge[u + 1]; e++) {
+            int slot = cursor[c.edgeTargets[e]]++;
+            c.reverseSources[slot] = u;
+            c.reverseEdges[slot] = e;
+        }
+    }
+
+    // Search keys, sorted bytewise, which for UTF-8 is code point order
+    std::vector<std::pair<QByteArray, int>> named;
+    for (const Node& node : nodes) {
+        if (!node.name.isEmpty()) {
+            named.push_back({node.name.toLower().toUtf8(), newId[node.id]});
+        }
+    }
+    std::sort(named.begin(), named.end());
+    c.keyOffsets.push_back(0);
+    for (const auto& entry : named) {
+        c.keyBytes.insert(c.keyBytes.end(), entry.first.constData(),
+                          entry.first.constData() + entry.first.size());
+        c.keyOffsets.push_back(static_cast<quint32>(c.keyBytes.size()));
+        c.keyNodes.push_back(entry.second);
+    }
+
+    RoadGraph graph;
+    graph.setSections({
+        {c.coords.data(), c.coords.size(), sizeof(FixedCoord)},
+        {c.nodeNameIds.data(), c.nodeNameIds.size(), sizeof(qint32)},
+        {c.externalIds.data(), c.externalIds.size(), sizeof(qint32)},
+        {c.internalIds.data(), c.internalIds.size(), sizeof(qint32)},
+        {c.firstEdge.data(), c.firstEdge.size(), sizeof(qint32)},
+        {c.edgeTargets.data(), c.edgeTargets.size(), sizeof(qint32)},
+        {c.edgeLengths.data(), c.edgeLengths.size(), sizeof(quint32)},
+        {c.edgeTimes.data(), c.edgeTimes.size(), sizeof(quint32)},
+        {c.edgeClasses.data(), c.edgeClasses.size(), sizeof(quint8)},
+        {c.edgeNameIds.data(), c.edgeNameIds.size(), sizeof(qint32)},
+        {c.nameOffsets.data(), c.nameOffsets.size(), sizeof(quint32)},
+        {c.nameBytes.data(), c.nameBytes.size(), sizeof(char)},
+        {c.reverseFirst.data(), c.reverseFirst.size(), sizeof(qint32)},
+        {c.reverseSources.data(), c.reverseSources.size(), sizeof(qint32)},
+        {c.reverseEdges.data(), c.reverseEdges.size(), sizeof(qint32)},
+        {c.keyOffsets.data(), c.keyOffsets.size(), sizeof(quint32)},
+        {c.keyBytes.data(), c.keyBytes.size(), sizeof(char)},
+        {c.keyNodes.data(), c.keyNodes.size(), sizeof(qint32)},
+        {&c.maxSpeed, 1, sizeof(double)}
+    });
+    graph.storage = columns;
+    return graph;
+}
@@ -0,0 +1,219 @@
+#ifndef ROADGRAPH_H
+#define ROADGRAPH_H
+
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+#include <memory>
+#include "datatypes.h"
+#include "nodeorder.h"
+
+// Read-only run of elements owned by someone else: the vectors a
+// RoadGraphBuilder produced, or a region of a mapped graph file.
+template <typename T>
+class ArrayView {
+public:
+    using value_type = T;
+
+    ArrayView() : items(nullptr), count(0) {}
+    ArrayView(const T* data, size_t size) : items(data), count(size) {}
+
+    const T& operator[](size_t i) const { return items[i]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T* data() const { return items; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+    const T& back() const { return items[count - 1]; }
+
+private:
+    const T* items;
+    size_t count;
+};
+
+// Checks for columns read from a file, an ArrayView or a std::vector.
+// Whether offsets start at zero, never decrease and end at end.
+template <typename Column>
+bool isOffsetColumn(const Column& offsets, quint64 end)
+{
+    if (offsets.empty() || offsets[0] != 0 || static_cast<quint64>(offsets.back()) != end) {
+        return false;
+    }
+    for (size_t i = 1; i < offsets.size(); i++) {
+        if (offsets[i] < offsets[i - 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether every value lies in [low, high)
+template <typename Column>
+bool isInRange(const Column& values, qint64 low, qint64 high)
+{
+    for (const auto& value : values) {
+        if (static_cast<qint64>(value) < low || static_cast<qint64>(value) >= high) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// UTF-8 strings stored back to back. String i is the byte range
+// [offsets[i], offsets[i + 1]); string 0 is always empty.
+struct StringTable {
+    ArrayView<quint32> offsets;
+    ArrayView<char> bytes;
+
+    int size() const { return offsets.empty() ? 0 : static_cast<int>(offsets.size()) - 1; }
+    bool isEmpty(int i) const { return offsets[i] == offsets[i + 1]; }
+    const char* utf8(int i) const { return bytes.data() + offsets[i]; }
+    int utf8Size(int i) const { return static_cast<int>(offsets[i + 1] - offsets[i]); }
+    QString at(int i) const { return QString::fromUtf8(utf8(i), utf8Size(i)); }
+};
+
+// Incoming edges of a RoadGraph in CSR form. The edges entering node v are
+// [firstEdge[v], firstEdge[v + 1]); each entry records the tail node and
+// the forward edge index, so weights are still read from the graph.
+struct ReverseIndex {
+    ArrayView<qint32> firstEdge;
+    ArrayView<qint32> sources;
+    ArrayView<qint32> edgeIds;
+};
+
+// Road network in compressed sparse row form.
+// Node ids are dense (0 .. nodeCount() - 1). The outgoing edges of node u
+// occupy the index range [edgeBegin(u), edgeEnd(u)) of the per-edge arrays,
+// which are stored as separate columns so a search only touches the data
+// it actually reads. Node and road names share one interned string table.
+//
+// Storage is compact: positions are FixedCoord, edge lengths and times are
+// whole decimetres and deciseconds, and a RoadClass byte per edge takes the
+// place of a speed, about 25 bytes per edge including the reverse index.
+//
+// Ids are internal: RoadGraphBuilder may renumber nodes for locality (see
+// NodeOrder). externalId() gives back the id addNode() returned, and
+// internalId() maps the other way.
+//
+// Every column is a flat little-endian array, so the graph can be written
+// to disk as is and later mapped back with load() and used in place.
+// Copies share the same immutable columns.
+class RoadGraph {
+public:
+    RoadGraph();
+
+    int nodeCount() const { return static_cast<int>(coords.size()); }
+    int edgeCount() const { return static_cast<int>(edgeTargets.size()); }
+    bool hasNode(int nodeId) const { return nodeId >= 0 && nodeId < nodeCount(); }
+
+    int externalId(int nodeId) const { return externalIds[nodeId]; }
+    // -1 for ids the builder never handed out
+    int internalId(int externalId) const {
+        return externalId >= 0 && externalId < nodeCount() ? internalIds[externalId] : -1;
+    }
+
+    GeoCoord coord(int nodeId) const { return coords[nodeId].toGeo(); }
+    FixedCoord fixedCoord(int nodeId) const { return coords[nodeId]; }
+    bool hasName(int nodeId) const { return !names.isEmpty(nodeNameIds[nodeId]); }
+    QString nodeName(int nodeId) const { return names.at(nodeNameIds[nodeId]); }
+
+    int edgeBegin(int nodeId) const { return firstEdge[nodeId]; }
+    int edgeEnd(int nodeId) const { return firstEdge[nodeId + 1]; }
+
+    int edgeTarget(int edge) const { return edgeTargets[edge]; }
+    // Meters
+    double edgeDistance(int edge) const { return edgeLengths[edge] * 0.1; }
+    // Seconds
+    double edgeTravelTime(int edge) const { return edgeTimes[edge] * 0.1; }
+    // Km/h, derived from the stored length and time
+    double edgeSpeed(int edge) const {
+        return edgeTimes[edge] > 0 ? edgeLengths[edge] * 3.6 / edgeTimes[edge] : 0.0;
+    }
+    RoadClass edgeClass(int edge) const { return static_cast<RoadClass>(edgeClasses[edge]); }
+    // Decimetres or deciseconds, exactly as stored
+    quint32 edgeWeight(int edge, RouteMetric metric) const {
+        return metric == RouteMetric::TravelTime ? edgeTimes[edge] : edgeLengths[edge];
+    }
+    double edgeCost(int edge, RouteMetric metric) const { return edgeWeight(edge, metric) * 0.1; }
+    int edgeRoadNameId(int edge) const { return edgeNameIds[edge]; }
+    QString edgeRoadName(int edge) const { return names.at(edgeNameIds[edge]); }
+
+    // Node and road names, indexed by edgeRoadNameId()
+    const StringTable& nameTable() const { return names; }
+    // Transposed edges for backward searches
+    const ReverseIndex& reverse() const { return reverseEdges; }
+    // Fastest edge in meters per second
+    double maxSpeed() const { return fastest; }
+
+    // Named nodes sorted by their lower-case name for prefix search. Entry i
+    // is node searchNode(i) under the key searchKeys().at(i).
+    const StringTable& searchKeys() const { return keys; }
+    int searchNode(int i) const { return keyNodes[i]; }
+
+    // Writes the graph in the binary format read by load()
+    bool save(const QString& path) const;
+    // Maps a file written by save() and uses it in place. The header is
+    // checked against its checksum and every index against the bounds the
+    // accessors rely on, so a damaged file fails to load rather than crash
+    // a query. verifyChecksum also checks the payload checksum, which
+    // additionally catches damaged weights, coordinates and names.
+    bool load(const QString& path, bool verifyChecksum = false);
+
+private:
+    friend class RoadGraphBuilder;
+
+    // One column as stored on disk, in the order of SectionId in the source
+    struct Section {
+        const void* data;
+        quint64 count;
+        quint32 elementSize;
+    };
+    std::vector<Section> sections() const;
+    void setSections(const std::vector<Section>& sections);
+    // Whether every offset and index column stays within its target
+    bool hasValidStructure() const;
+
+    ArrayView<FixedCoord> coords;
+    ArrayView<qint32> nodeNameIds;    // index into names
+    ArrayView<qint32> externalIds;
+    ArrayView<qint32> internalIds;    // indexed by external id
+
+    ArrayView<qint32> firstEdge;      // nodeCount() + 1 offsets
+    ArrayView<qint32> edgeTargets;
+    ArrayView<quint32> edgeLengths;   // Decimetres
+    ArrayView<quint32> edgeTimes;     // Deciseconds
+    ArrayView<quint8> edgeClasses;    // RoadClass
+    ArrayView<qint32> edgeNameIds;    // index into names
+
+    StringTable names;
+    ReverseIndex reverseEdges;
+    StringTable keys;
+    ArrayView<qint32> keyNodes;
+    double fastest;
+
+    // Owns whatever the views above point into
+    std::shared_ptr<const void> storage;
+};
+
+// Collects nodes and edges in any order and packs them into a RoadGraph.
+class RoadGraphBuilder {
+public:
+    // Returns the dense id assigned to the new node.
+    int addNode(double lat, double lon, const QString& name = QString());
+    void addEdge(int fromNode, const Edge& edge);
+    // Adds both directions of a road, measuring its length from the node coordinates.
+    void addRoad(int nodeA, int nodeB, double speed, const QString& roadName);
+
+    const GeoCoord& coord(int nodeId) const { return nodes[nodeId].coord; }
+    int nodeCount() const { return static_cast<int>(nodes.size()); }
+
+    // Packs the graph, numbering its nodes in the given order
+    RoadGraph build(NodeOrder order = NodeOrder::Insertion) const;
+
+private:
+    std::vector<Node> nodes;
+    std::vector<int> edgeSources;
+    std::vector<Edge> edges;
+};
+
+#endif // ROADGRAPH_H
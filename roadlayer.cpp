@@ -0,0 +1,363 @@
+#include "roadlayer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+// Width in pixels whatever the painter's transform
+QPen cosmeticPen(const QColor& color, qreal width, Qt::PenCapStyle cap)
+{
+    QPen pen(color, width, Qt::SolidLine, cap);
+    pen.setCosmetic(true);
+    return pen;
+}
+
+struct LevelSpec {
+    double minScale;
+    RoadClass lowestClass;      // Least important class drawn
+    double tolerance;           // In world units
+};
+
+// Finest first. Each level is simplified to within half a pixel at the
+// largest scale it is used at; the finest, used up to the view's 30 pixels
+// per unit, only merges edges that are all but collinear.
+const LevelSpec LevelSpecs[] = {
+    {0.5, RoadClass::Service, 0.01},
+    {0.125, RoadClass::Local, 0.5 / 0.5},
+    {0.0, RoadClass::Secondary, 0.5 / 0.125}
+};
+
+// Nodes of a run of segments in one style, joined end to end
+struct Chain {
+    RoadLayer::Style style;
+    std::vector<int> nodes;
+};
+
+// Joins the segments into chains through every node where exactly two of
+// them meet in the same style. Each segment ends up in one chain.
+std::vector<Chain> joinSegments(const std::vector<RoadSegment>& segments,
+                                const std::vector<RoadLayer::Style>& styles, int nodeCount)
+{
+    // Segments at each node: incident[first[u] .. first[u + 1])
+    std::vector<int> first(nodeCount + 1, 0);
+    for (const RoadSegment& segment : segments) {
+        first[segment.source + 1]++;
+        first[segment.target + 1]++;
+    }
+    std::partial_sum(first.begin(), first.end(), first.begin());
+    std::vector<int> incident(first.back());
+    std::vector<int> next(first.begin(), first.end() - 1);
+    for (int s = 0; s < static_cast<int>(segments.size()); s++) {
+        incident[next[segments[s].source]++] = s;
+        incident[next[segments[s].target]++] = s;
+    }
+
+    auto passesThrough = [&](int u) {
+        if (first[u + 1] - first[u] != 2) {
+            return false;
+        }
+        const int a = incident[first[u]];
+        const int b = incident[first[u] + 1];
+        return a != b && styles[a] == styles[b];
+    };
+
+    std::vector<char> used(segments.size(), 0);
+    std::vector<Chain> chains;
+    auto walk = [&](int start, int s) {
+        Chain chain{styles[s], {start}};
+        int u = start;
+        while (true) {
+            used[s] = 1;
+            u = segments[s].source == u ? segments[s].target : segments[s].source;
+            chain.nodes.push_back(u);
+            if (!passesThrough(u)) {
+                break;
+            }
+            const int a = incident[first[u]];
+            s = a == s ? incident[first[u] + 1] : a;
+            if (used[s]) {
+                break;      // Back where a loop started
+            }
+        }
+        chains.push_back(std::move(chain));
+    };
+
+    for (int u = 0; u < nodeCount; u++) {
+        if (!passesThrough(u)) {
+            for (int i = first[u]; i < first[u + 1]; i++) {
+                if (!used[incident[i]]) {
+                    walk(u, incident[i]);
+                }
+            }
+        }
+    }
+    // Whatever is left forms loops without an end
+    for (int s = 0; s < static_cast<int>(segments.size()); s++) {
+        if (!used[s]) {
+            walk(segments[s].source, s);
+        }
+    }
+    return chains;
+}
+
+double distanceToSegment(const QPointF& p, const QPointF& a, const QPointF& b)
+{
+    const QPointF ab = b - a;
+    const double length2 = QPointF::dotProduct(ab, ab);
+    double t = length2 > 0.0 ? QPointF::dotProduct(p - a, ab) / length2 : 0.0;
+    t = std::min(std::max(t, 0.0), 1.0);
+    const QPointF d = p - (a + ab * t);
+    return std::sqrt(QPointF::dotProduct(d, d));
+}
+
+// Douglas-Peucker: flags the points kept so that none of those dropped
+// lies further than tolerance from the simplified polyline. The ends stay.
+void simplify(const std::vector<QPointF>& points, double tolerance, std::vector<char>& keep)
+{
+    keep.assign(points.size(), 0);
+    keep.front() = keep.back() = 1;
+
+    std::vector<std::pair<int, int>> spans = {{0, static_cast<int>(points.size()) - 1}};
+    while (!spans.empty()) {
+        const auto [a, b] = spans.back();
+        spans.pop_back();
+
+        double worst = tolerance;
+        int farthest = -1;
+        for (int i = a + 1; i < b; i++) {
+            const double d = distanceToSegment(points[i], points[a], points[b]);
+            if (d > worst) {
+                worst = d;
+                farthest = i;
+            }
+        }
+        if (farthest >= 0) {
+            keep[farthest] = 1;
+            spans.push_back({a, farthest});
+            spans.push_back({farthest, b});
+        }
+    }
+}
+
+} // namespace
+
+RoadLayer::RoadLayer()
+{
+}
+
+RoadLayer::RoadLayer(const GraphSnapshot& snapshot)
+    : RoadLayer()
+{
+    const RoadGraph& graph = snapshot.graph();
+    const std::vector<RoadSegment>& segments = snapshot.spatialIndex().roadSegments();
+    if (segments.empty()) {
+        return;
+    }
+
+    double minX = 0.0, maxX = 0.0, minY = 0.0, maxY = 0.0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        const QPointF a = toWorld(graph.coord(segments[i].source));
+        const QPointF b = toWorld(graph.coord(segments[i].target));
+        if (i == 0) {
+            minX = maxX = a.x();
+            minY = maxY = a.y();
+        }
+        minX = std::min({minX, a.x(), b.x()});
+        maxX = std::max({maxX, a.x(), b.x()});
+        minY = std::min({minY, a.y(), b.y()});
+        maxY = std::max({maxY, a.y(), b.y()});
+    }
+    bounds = QRectF(QPointF(minX, minY), QPointF(maxX, maxY));
+
+    std::vector<RoadSegment> kept;
+    std::vector<Style> keptStyles;
+    std::vector<QPointF> points;
+    std::vector<char> keep;
+    for (const LevelSpec& spec : LevelSpecs) {
+        kept.clear();
+        keptStyles.clear();
+        for (const RoadSegment& segment : segments) {
+            const RoadClass roadClass = graph.edgeClass(segment.edge);
+            if (roadClass <= spec.lowestClass) {
+                kept.push_back(segment);
+                keptStyles.push_back(styleOf(roadClass));
+            }
+        }
+
+        std::vector<QLineF> lines;
+        std::vector<Style> styles;
+        for (const Chain& chain : joinSegments(kept, keptStyles, graph.nodeCount())) {
+            points.clear();
+            for (int u : chain.nodes) {
+                points.push_back(toWorld(graph.coord(u)));
+            }
+            simplify(points, spec.tolerance, keep);
+
+            size_t from = 0;
+            for (size_t i = 1; i < points.size(); i++) {
+                if (keep[i]) {
+                    lines.emplace_back(points[from], points[i]);
+                    styles.push_back(chain.style);
+                    from = i;
+                }
+            }
+        }
+
+        Level level;
+        level.minScale = spec.minScale;
+        fileLines(level, lines, styles);
+        levels.push_back(std::move(level));
+    }
+}
+
+void RoadLayer::fileLines(Level& level, const std::vector<QLineF>& lines,
+                          const std::vector<Style>& styles) const
+{
+    level.lineCount = static_cast<int>(lines.size());
+    if (lines.empty()) {
+        level.columns = level.rows = 1;
+        for (Bucket& bucket : level.buckets) {
+            bucket.cellFirst.assign(2, 0);
+        }
+        return;
+    }
+
+    // About sixteen lines per cell, and never many more cells than lines
+    const double width = std::max(bounds.width(), 1.0);
+    const double height = std::max(bounds.height(), 1.0);
+    level.cellSize = std::max(std::sqrt(width * height * 16.0 / level.lineCount), 1.0);
+    while ((width / level.cellSize + 1) * (height / level.cellSize + 1) > level.lineCount + 16.0) {
+        level.cellSize *= 2.0;
+    }
+    level.columns = static_cast<int>(width / level.cellSize) + 1;
+    level.rows = static_cast<int>(height / level.cellSize) + 1;
+
+    // Cell of every short line, -1 for long ones
+    std::vector<int> cells(lines.size());
+    for (size_t i = 0; i < lines.size(); i++) {
+        const QLineF& line = lines[i];
+        if (std::max(std::abs(line.dx()), std::abs(line.dy())) > level.cellSize) {
+            cells[i] = -1;
+        } else {
+            const QPointF middle = line.center();
+            cells[i] = row(level, middle.y()) * level.columns + column(level, middle.x());
+        }
+    }
+
+    for (int style = 0; style < StyleCount; style++) {
+        Bucket& bucket = level.buckets[style];
+        bucket.cellFirst.assign(level.columns * level.rows + 1, 0);
+
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (styles[i] != style) {
+                continue;
+            }
+            if (cells[i] < 0) {
+                bucket.longLines.push_back(lines[i]);
+            } else {
+                bucket.cellFirst[cells[i] + 1]++;
+            }
+        }
+        std::partial_sum(bucket.cellFirst.begin(), bucket.cellFirst.end(), bucket.cellFirst.begin());
+
+        bucket.lines.resize(bucket.cellFirst.back());
+        std::vector<int> next(bucket.cellFirst.begin(), bucket.cellFirst.end() - 1);
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (cells[i] >= 0 && styles[i] == style) {
+                bucket.lines[next[cells[i]]++] = lines[i];
+            }
+        }
+    }
+}
+
+int RoadLayer::lineCount(double scale) const
+{
+    return levels.empty() ? 0 : levelFor(scale).lineCount;
+}
+
+void RoadLayer::collect(Style style, const QRectF& worldRect, double scale,
+                        std::vector<QLineF>& lines) const
+{
+    lines.clear();
+    if (levels.empty()) {
+        return;
+    }
+
+    const Level& level = levelFor(scale);
+    const Bucket& bucket = level.buckets[style];
+    const QRectF view = worldRect.normalized();
+
+    // A short line touching the view has its midpoint within half a cell of it
+    const double half = level.cellSize / 2;
+    const QRectF reach = view.adjusted(-half, -half, half, half);
+    if (reach.right() >= bounds.left() && reach.left() <= bounds.right() &&
+        reach.bottom() >= bounds.top() && reach.top() <= bounds.bottom()) {
+        const int firstColumn = column(level, reach.left());
+        const int lastColumn = column(level, reach.right());
+        for (int y = row(level, reach.top()); y <= row(level, reach.bottom()); y++) {
+            // The cells of one row are contiguous, and so are their lines
+            lines.insert(lines.end(),
+                         bucket.lines.begin() + bucket.cellFirst[y * level.columns + firstColumn],
+                         bucket.lines.begin() + bucket.cellFirst[y * level.columns + lastColumn + 1]);
+        }
+    }
+
+    for (const QLineF& line : bucket.longLines) {
+        if (std::max(line.x1(), line.x2()) >= view.left() &&
+            std::min(line.x1(), line.x2()) <= view.right() &&
+            std::max(line.y1(), line.y2()) >= view.top() &&
+            std::min(line.y1(), line.y2()) <= view.bottom()) {
+            lines.push_back(line);
+        }
+    }
+}
+
+void RoadLayer::paint(QPainter& painter, const QRectF& worldRect, double scale) const
+{
+    // Highways - orange, regular roads - gray
+    static const QPen casings[StyleCount] = {
+        cosmeticPen(QColor(189, 195, 199), 5, Qt::RoundCap),
+        cosmeticPen(QColor(255, 167, 38, 180), 6, Qt::RoundCap)
+    };
+    static const QPen fills[StyleCount] = {
+        cosmeticPen(QColor(236, 240, 241), 3, Qt::SquareCap),
+        cosmeticPen(QColor(255, 193, 7), 4, Qt::SquareCap)
+    };
+
+    std::vector<QLineF> lines[StyleCount];
+    for (int style = 0; style < StyleCount; style++) {
+        collect(static_cast<Style>(style), worldRect, scale, lines[style]);
+    }
+
+    for (const QPen* pens : {casings, fills}) {
+        for (int style = 0; style < StyleCount; style++) {
+            if (!lines[style].empty()) {
+                painter.setPen(pens[style]);
+                painter.drawLines(lines[style].data(), static_cast<int>(lines[style].size()));
+            }
+        }
+    }
+}
+
+const RoadLayer::Level& RoadLayer::levelFor(double scale) const
+{
+    for (const Level& level : levels) {
+        if (scale >= level.minScale) {
+            return level;
+        }
+    }
+    return levels.back();
+}
+
+int RoadLayer::column(const Level& level, double x) const
+{
+    return static_cast<int>(std::min(std::max(std::floor((x - bounds.left()) / level.cellSize), 0.0),
+                                     level.columns - 1.0));
+}
+
+int RoadLayer::row(const Level& level, double y) const
+{
+    return static_cast<int>(std::min(std::max(std::floor((y - bounds.top()) / level.cellSize), 0.0),
+                                     level.rows - 1.0));
+}
@@ -0,0 +1,91 @@
+#ifndef ROADLAYER_H
+#define ROADLAYER_H
+
+#include <QLineF>
+#include <QPainter>
+#include <QRectF>
+#include <vector>
+#include "datatypes.h"
+#include "graphsnapshot.h"
+
+// Road geometry prepared for painting, built once per graph snapshot.
+//
+// Each road appears once, whichever directions it has, as a line in world
+// coordinates (see toWorld()), grouped by drawing style and within a style
+// by grid cell. A frame gathers the lines near the viewport with a few
+// range copies and draws a whole style with one drawLines call per pass,
+// under a painter transform and cosmetic pens, instead of setting a pen
+// and drawing for every edge.
+//
+// The roads are kept at a few levels of detail, each used from a minimum
+// scale up. Coarser levels leave out the minor road classes, join roads
+// through nodes where only two of them meet and simplify the resulting
+// polylines with Douglas-Peucker, so a zoomed-out frame strokes about as
+// many lines as a zoomed-in one rather than every edge of a large area.
+class RoadLayer {
+public:
+    // In drawing order, lowest first
+    enum Style {
+        Regular,
+        Highway,
+        StyleCount
+    };
+
+    RoadLayer();
+    explicit RoadLayer(const GraphSnapshot& snapshot);
+
+    // The map's unscaled plane: x grows east, y grows south, 1e5 units per degree
+    static QPointF toWorld(const GeoCoord& coord) {
+        return QPointF(coord.lon * 100000.0, -coord.lat * 100000.0);
+    }
+
+    static Style styleOf(RoadClass roadClass) {
+        return roadClass <= RoadClass::Primary ? Highway : Regular;
+    }
+
+    bool isEmpty() const { return levels.empty(); }
+    // Smallest world rectangle holding every road
+    QRectF worldBounds() const { return bounds; }
+    // Lines in the whole map at the level of detail for scale
+    int lineCount(double scale) const;
+
+    // Replaces lines with the roads of the style that may cross the world
+    // rectangle, at the level of detail for scale pixels per world unit.
+    // Some lie just outside the rectangle; the painter clips those.
+    void collect(Style style, const QRectF& worldRect, double scale, std::vector<QLineF>& lines) const;
+
+    // Draws the roads crossing the world rectangle, all casings first and
+    // then all fills. The painter's transform must map world coordinates
+    // to its device at scale; pen widths stay in pixels.
+    void paint(QPainter& painter, const QRectF& worldRect, double scale) const;
+
+private:
+    // Lines no longer than a cell are filed under the cell of their
+    // midpoint: cell c holds lines[cellFirst[c] .. cellFirst[c + 1]).
+    // Longer ones are tested one by one.
+    struct Bucket {
+        std::vector<QLineF> lines;
+        std::vector<int> cellFirst;
+        std::vector<QLineF> longLines;
+    };
+
+    // The roads as drawn from minScale up to the next finer level
+    struct Level {
+        double minScale = 0.0;
+        double cellSize = 1.0;
+        int columns = 0;
+        int rows = 0;
+        int lineCount = 0;
+        Bucket buckets[StyleCount];
+    };
+
+    void fileLines(Level& level, const std::vector<QLineF>& lines, const std::vector<Style>& styles) const;
+    const Level& levelFor(double scale) const;
+    int column(const Level& level, double x) const;
+    int row(const Level& level, double y) const;
+
+    QRectF bounds;
+    std::vector<Level> levels;      // Finest first
+};
+
+#endif // ROADLAYER_H
@@ -1,101 +1,924 @@
 #include "router.h"
-#include <unordered_map>
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QMutexLocker>
+#include <QScopeGuard>
 #include <limits>
 #include <algorithm>
 
+namespace {
+
+const int ActiveLandmarkCount = 4;
+const int DefaultLandmarkCount = 16;
+
+// An edge, or the part of it given in decimetres, ending at to. Edge -1 is
+// a straight line where no edge joins two consecutive nodes.
+struct RouteLeg {
+    int edge;
+    quint64 decimetres;
+    GeoCoord to;
+};
+
+// The way between a snapped point and one end of its edge: that fraction
+// of edge. With fraction 0 the point is the node and edge may be -1.
+struct EdgePart {
+    int node;
+    int edge;
+    double fraction;
+
+    bool usable() const { return edge >= 0 || fraction == 0.0; }
+    double cost(const RoadGraph& graph, RouteMetric metric) const {
+        return fraction == 0.0 ? 0.0 : fraction * graph.edgeCost(edge, metric);
+    }
+    RouteLeg leg(const RoadGraph& graph, const GeoCoord& to) const {
+        return {edge, static_cast<quint64>(fraction * graph.edgeWeight(edge, RouteMetric::Distance) + 0.5), to};
+    }
+};
+
+// The cheapest of the parallel edges from one node to another, or -1
+int cheapestEdge(const RoadGraph& graph, int from, int to, RouteMetric metric)
+{
+    int best = -1;
+    for (int e = graph.edgeBegin(from); e < graph.edgeEnd(from); e++) {
+        if (graph.edgeTarget(e) == to &&
+            (best < 0 || graph.edgeWeight(e, metric) < graph.edgeWeight(best, metric))) {
+            best = e;
+        }
+    }
+    return best;
+}
+
+// The edges the search took between consecutive nodes of path, or straight
+// lines where none joins them
+std::vector<RouteLeg> pathLegs(const RoadGraph& graph, const std::vector<int>& path, RouteMetric metric)
+{
+    std::vector<RouteLeg> legs;
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        const int best = cheapestEdge(graph, path[i], path[i + 1], metric);
+        const quint64 decimetres =
+            best >= 0 ? graph.edgeWeight(best, RouteMetric::Distance)
+                      : toDecimetres(graph.coord(path[i]).distanceTo(graph.coord(path[i + 1])));
+        legs.push_back({best, decimetres, graph.coord(path[i + 1])});
+    }
+    return legs;
+}
+
+// One step per run of legs on the same road, the last one heading for
+// endName when there is one
+std::vector<RouteStep> describeLegs(const RoadGraph& graph, const QString& startInstruction,
+                                    const GeoCoord& startLocation, const std::vector<RouteLeg>& legs,
+                                    const QString& endName)
+{
+    std::vector<RouteStep> route;
+
+    RouteStep start;
+    start.instruction = startInstruction;
+    start.distance = 0;
+    start.location = startLocation;
+    route.push_back(start);
+
+    for (size_t i = 0; i < legs.size();) {
+        const int nameId = legs[i].edge >= 0 ? graph.edgeRoadNameId(legs[i].edge) : 0;
+
+        RouteStep step;
+        quint64 decimetres = 0;
+        size_t end = i;
+        for (; end < legs.size() && legs[end].edge >= 0 && graph.edgeRoadNameId(legs[end].edge) == nameId;
+             end++) {
+            decimetres += legs[end].decimetres;
+            if (end > i) {
+                step.shape.push_back(legs[end - 1].to);
+            }
+        }
+        if (end == i) {
+            decimetres = legs[i].decimetres;
+            end = i + 1;
+        }
+
+        step.distance = decimetres * 0.1;
+        step.location = legs[end - 1].to;
+
+        const QString length = step.distance >= 1000.0
+                                   ? QString("%1 km").arg(step.distance / 1000.0, 0, 'f', 1)
+                                   : QString("%1 m").arg(static_cast<int>(step.distance));
+        if (nameId > 0) {
+            step.instruction = QString("Continue on %1 for %2")
+                                   .arg(graph.nameTable().at(nameId)).arg(length);
+        } else {
+            step.instruction = QString("Continue for %1").arg(length);
+        }
+        if (end == legs.size() && !endName.isEmpty()) {
+            step.instruction += " to " + endName;
+        }
+
+        route.push_back(std::move(step));
+        i = end;
+    }
+
+    return route;
+}
+
+} // namespace
+
 Router::Router(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+    mode(RoutingMode::Dijkstra),
+    metric(RouteMetric::Distance),
+    queueKind(HeapKind::FourAry),
+    lastRequestId(0)
+{
+    auto initial = std::make_shared<State>();
+    initial->snapshot = GraphSnapshot::create(RoadGraph());
+    state = initial;
+}
+
+Router::~Router()
+{
+    cancelRoute();
+    if (prepareControl) {
+        prepareControl->cancelled = true;
+    }
+    workers.waitForDone();
+}
+
+Router::StatePtr Router::currentState() const
+{
+    return std::atomic_load(&state);
+}
+
+void Router::publish(const StatePtr& next)
+{
+    std::atomic_store(&state, next);
+}
+
+bool Router::install(const GraphSnapshotPtr& builtFor, RouteMetric routeMetric,
+                     const std::shared_ptr<const ContractionHierarchy>& hierarchy,
+                     const std::shared_ptr<const LandmarkIndex>& landmarks)
+{
+    QMutexLocker locker(&publishLock);
+    StatePtr current = currentState();
+    if (current->snapshot != builtFor) {
+        return false;
+    }
+
+    auto next = std::make_shared<State>(*current);
+    if (hierarchy) {
+        next->hierarchies[static_cast<int>(routeMetric)] = hierarchy;
+    }
+    if (landmarks) {
+        next->landmarkIndexes[static_cast<int>(routeMetric)] = landmarks;
+        next->previousLandmarks[static_cast<int>(routeMetric)].reset();
+    }
+    publish(next);
+    return true;
+}
+
+void Router::setGraph(const GraphSnapshotPtr& snapshot)
 {
+    QMutexLocker locker(&publishLock);
+    StatePtr old = currentState();
+    auto next = std::make_shared<State>();
+    next->snapshot = snapshot;
+
+    // Whether the landmarks can stay is only known after comparing the
+    // nodes, which is left to prepare() on a worker
+    for (int i = 0; i < 2; i++) {
+        next->previousLandmarks[i] = old->landmarkIndexes[i] ? old->landmarkIndexes[i]
+                                                             : old->previousLandmarks[i];
+    }
+
+    publish(next);
 }
 
-void Router::setGraph(const AdjacencyList& g, const std::vector<Node>& n)
+GraphSnapshotPtr Router::graphSnapshot() const
 {
-    graph = g;
-    nodes = n;
+    return currentState()->snapshot;
 }
 
 GeoCoord Router::getNodeCoord(int nodeId) const
 {
-    if (nodeId >= 0 && nodeId < static_cast<int>(nodes.size())) {
-        return nodes[nodeId].coord;
+    StatePtr current = currentState();
+    if (current->snapshot->graph().hasNode(nodeId)) {
+        return current->snapshot->graph().coord(nodeId);
     }
     return GeoCoord();
 }
 
+EdgeSnap Router::snapToRoad(const GeoCoord& coord) const
+{
+    return currentState()->snapshot->spatialIndex().nearestEdge(coord);
+}
+
+void Router::buildContractionHierarchy()
+{
+    StatePtr current = currentState();
+    auto hierarchy = std::make_shared<ContractionHierarchy>();
+    hierarchy->build(current->snapshot->graph(), metric);
+    install(current->snapshot, metric, hierarchy, nullptr);
+}
+
+bool Router::hasContractionHierarchy() const
+{
+    return currentState()->hierarchies[static_cast<int>(metric)] != nullptr;
+}
+
+bool Router::saveContractionHierarchy(const QString& path) const
+{
+    StatePtr current = currentState();
+    const auto& hierarchy = current->hierarchies[static_cast<int>(metric)];
+    return hierarchy && hierarchy->save(path);
+}
+
+bool Router::loadContractionHierarchy(const QString& path)
+{
+    StatePtr current = currentState();
+    auto loaded = std::make_shared<ContractionHierarchy>();
+    if (!loaded->load(path, current->snapshot->graph()) || loaded->metric() != metric) {
+        return false;
+    }
+    return install(current->snapshot, metric, loaded, nullptr);
+}
+
+int Router::contractionShortcutCount() const
+{
+    StatePtr current = currentState();
+    const auto& hierarchy = current->hierarchies[static_cast<int>(metric)];
+    return hierarchy ? hierarchy->shortcutCount() : 0;
+}
+
+void Router::buildLandmarks(int count, LandmarkSelection selection)
+{
+    StatePtr current = currentState();
+    auto index = std::make_shared<LandmarkIndex>();
+    index->build(current->snapshot->graph(), current->snapshot->reverse(), metric, count, selection);
+    install(current->snapshot, metric, nullptr, index);
+}
+
+bool Router::hasLandmarks() const
+{
+    return currentState()->landmarkIndexes[static_cast<int>(metric)] != nullptr;
+}
+
+double Router::lowerBound(const State& routing, const RouteQuery& query, int nodeId,
+                          const std::vector<int>& activeLandmarks) const
+{
+    if (query.mode == RoutingMode::ALT) {
+        const auto& landmarks = routing.landmarkIndexes[static_cast<int>(query.metric)];
+        return landmarks ? landmarks->lowerBound(nodeId, query.endNodeId, activeLandmarks) : 0.0;
+    }
+    if (query.mode != RoutingMode::AStar) {
+        return 0.0;
+    }
+
+    // Edge lengths are never shorter than the great-circle distance between
+    // their endpoints, so the straight line is admissible and consistent
+    const RoadGraph& graph = routing.snapshot->graph();
+    const double maxSpeed = routing.snapshot->maxSpeed();
+    double dist = graph.coord(nodeId).distanceTo(graph.coord(query.endNodeId));
+    if (query.metric == RouteMetric::TravelTime) {
+        return maxSpeed > 0.0 ? dist / maxSpeed : 0.0;
+    }
+    return dist;
+}
+
+bool Router::prepare(RoutingMode m, RouteMetric routeMetric, QueryControl* control)
+{
+    const int index = static_cast<int>(routeMetric);
+    auto missing = [&](const State& routing) {
+        return (m == RoutingMode::ContractionHierarchy && !routing.hierarchies[index]) ||
+               (m == RoutingMode::ALT && !routing.landmarkIndexes[index]);
+    };
+    if (!missing(*currentState())) {
+        return true;
+    }
+
+    // One build at a time, so a caller that has to wait usually finds its
+    // structure ready once it gets the lock
+    while (!prepareLock.tryLock(50)) {
+        if (control && control->cancelled.load()) {
+            return false;
+        }
+    }
+    auto unlock = qScopeGuard([this]() { prepareLock.unlock(); });
+
+    StatePtr current = currentState();
+    if (!missing(*current)) {
+        return true;
+    }
+
+    const GraphSnapshot& snapshot = *current->snapshot;
+    if (m == RoutingMode::ContractionHierarchy) {
+        auto hierarchy = std::make_shared<ContractionHierarchy>();
+        if (!hierarchy->build(snapshot.graph(), routeMetric, control)) {
+            return false;
+        }
+        install(current->snapshot, routeMetric, hierarchy, nullptr);
+    } else {
+        // Landmarks stay good choices while the nodes are the same, so
+        // only their tables need recomputing for the new weights
+        const auto& previous = current->previousLandmarks[index];
+        std::shared_ptr<LandmarkIndex> landmarks;
+        if (previous && previous->sameNodes(snapshot.graph())) {
+            landmarks = std::make_shared<LandmarkIndex>(*previous);
+            if (!landmarks->refresh(snapshot.graph(), snapshot.reverse(), control)) {
+                return false;
+            }
+        } else {
+            landmarks = std::make_shared<LandmarkIndex>();
+            if (!landmarks->build(snapshot.graph(), snapshot.reverse(), routeMetric, DefaultLandmarkCount,
+                                  LandmarkSelection::Avoid, control)) {
+                return false;
+            }
+        }
+        install(current->snapshot, routeMetric, nullptr, landmarks);
+    }
+    return true;
+}
+
+void Router::prepareAsync(RoutingMode m, RouteMetric routeMetric, const QString& cachePath)
+{
+    if (prepareControl) {
+        prepareControl->cancelled = true;
+    }
+    auto control = std::make_shared<QueryControl>();
+    prepareControl = control;
+
+    auto* watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, control, m, routeMetric]() {
+        const bool fromCache = watcher->result();
+        watcher->deleteLater();
+
+        if (prepareControl == control) {
+            prepareControl.reset();
+        }
+        if (!control->cancelled.load()) {
+            emit prepareFinished(m, routeMetric, fromCache);
+        }
+    });
+
+    watcher->setFuture(QtConcurrent::run(&workers, [this, m, routeMetric, cachePath, control]() {
+        StatePtr current = currentState();
+        const auto& hierarchy = current->hierarchies[static_cast<int>(routeMetric)];
+        if (m != RoutingMode::ContractionHierarchy || cachePath.isEmpty() || hierarchy) {
+            prepare(m, routeMetric, control.get());
+            return false;
+        }
+
+        // Loading a hierarchy saved for this graph is far cheaper than
+        // building it again
+        auto loaded = std::make_shared<ContractionHierarchy>();
+        if (loaded->load(cachePath, current->snapshot->graph()) && loaded->metric() == routeMetric) {
+            install(current->snapshot, routeMetric, loaded, nullptr);
+            return true;
+        }
+
+        if (prepare(m, routeMetric, control.get())) {
+            StatePtr prepared = currentState();
+            const auto& built = prepared->hierarchies[static_cast<int>(routeMetric)];
+            if (built) {
+                built->save(cachePath);
+            }
+        }
+        return false;
+    }));
+}
+
+RouteQuery Router::makeQuery(int startNodeId, int endNodeId) const
+{
+    RouteQuery query;
+    query.startNodeId = startNodeId;
+    query.endNodeId = endNodeId;
+    query.mode = mode;
+    query.metric = metric;
+    query.heapKind = queueKind;
+    return query;
+}
+
 std::vector<RouteStep> Router::findRoute(int startNodeId, int endNodeId)
 {
-    std::vector<RouteStep> route;
+    prepare(mode, metric);
+    RouteResult result = route(makeQuery(startNodeId, endNodeId));
+    stats = result.stats;
+    return result.steps;
+}
+
+std::vector<RouteStep> Router::findRoute(const GeoCoord& from, const GeoCoord& to)
+{
+    RouteResult result = routeBetween(from, to, metric, queueKind);
+    stats = result.stats;
+    return result.steps;
+}
+
+RouteResult Router::routeBetween(const GeoCoord& from, const GeoCoord& to, RouteMetric routeMetric,
+                                 HeapKind kind, QueryControl* control) const
+{
+    RouteResult result;
+
+    // The snaps name edges of this state's graph, so both come from it
+    StatePtr routing = currentState();
+    const RoadGraph& graph = routing->snapshot->graph();
+    const EdgeSnap start = routing->snapshot->spatialIndex().nearestEdge(from);
+    const EdgeSnap end = routing->snapshot->spatialIndex().nearestEdge(to);
+    if (start.edge < 0 || end.edge < 0) {
+        return result;
+    }
+
+    // Off the start road back to its source or on to its target, and onto
+    // the end road from its source or, against it, from its target. The
+    // ways against an edge need the road to run both ways.
+    const EdgePart exits[2] = {
+        {start.source, cheapestEdge(graph, start.target, start.source, routeMetric), start.fraction},
+        {start.target, start.edge, 1.0 - start.fraction}
+    };
+    const EdgePart entries[2] = {
+        {end.source, end.edge, end.fraction},
+        {end.target, cheapestEdge(graph, end.target, end.source, routeMetric), 1.0 - end.fraction}
+    };
+
+    // Both on one road, the way straight along it
+    double best = std::numeric_limits<double>::infinity();
+    int bestEntry = -1;
+    std::vector<RouteLeg> legs;
+    if (start.edge == end.edge) {
+        const EdgePart along = end.fraction >= start.fraction
+                                   ? EdgePart{-1, start.edge, end.fraction - start.fraction}
+                                   : EdgePart{-1, exits[0].edge, start.fraction - end.fraction};
+        if (along.usable()) {
+            best = along.cost(graph, routeMetric);
+        }
+        if (along.fraction > 0.0 && along.usable()) {
+            legs.push_back(along.leg(graph, end.point));
+        }
+    }
+
+    QueryWorkspace& ws = QueryWorkspace::local();
+    ws.startQuery(graph.nodeCount(), kind);
+    for (const EdgePart& exit : exits) {
+        const double cost = exit.cost(graph, routeMetric);
+        if (exit.usable() && cost < ws.distance(exit.node)) {
+            ws.setDistance(exit.node, cost);
+            ws.push(exit.node, cost, cost);
+        }
+    }
 
-    if (graph.find(startNodeId) == graph.end() ||
-        graph.find(endNodeId) == graph.end()) {
-        return route;
+    while (!ws.empty()) {
+        QueryWorkspace::HeapEntry current = ws.top();
+        ws.pop();
+
+        if (current.cost > ws.distance(current.node)) {
+            continue;
+        }
+        // The rest of the way onto the end road only adds to the cost
+        if (current.cost >= best) {
+            break;
+        }
+
+        result.stats.settledNodes++;
+        if (control && control->poll(result.stats.settledNodes)) {
+            result.cancelled = true;
+            return result;
+        }
+
+        for (int i = 0; i < 2; i++) {
+            if (entries[i].node == current.node && entries[i].usable() &&
+                current.cost + entries[i].cost(graph, routeMetric) < best) {
+                best = current.cost + entries[i].cost(graph, routeMetric);
+                bestEntry = i;
+            }
+        }
+
+        for (int e = graph.edgeBegin(current.node); e < graph.edgeEnd(current.node); e++) {
+            int next = graph.edgeTarget(e);
+            double newCost = current.cost + graph.edgeCost(e, routeMetric);
+            result.stats.relaxedEdges++;
+
+            if (newCost < ws.distance(next)) {
+                ws.setDistance(next, newCost, current.node, e);
+                ws.push(next, newCost, newCost);
+            }
+        }
     }
 
-    std::priority_queue<State, std::vector<State>, std::greater<State>> pq;
-    std::unordered_map<int, double> distances;
-    std::unordered_map<int, int> previous;
+    if (bestEntry >= 0) {
+        std::vector<int> path;
+        for (int current = entries[bestEntry].node; current >= 0; current = ws.parent(current)) {
+            path.push_back(current);
+        }
+        std::reverse(path.begin(), path.end());
 
-    for (const auto& node : nodes) {
-        distances[node.id] = std::numeric_limits<double>::infinity();
+        // The search started at whichever end of the start road path does
+        const EdgePart& exit = exits[0].node == path.front() ? exits[0] : exits[1];
+        legs.clear();
+        if (exit.fraction > 0.0) {
+            legs.push_back(exit.leg(graph, graph.coord(exit.node)));
+        }
+        const std::vector<RouteLeg> between = pathLegs(graph, path, routeMetric);
+        legs.insert(legs.end(), between.begin(), between.end());
+        if (entries[bestEntry].fraction > 0.0) {
+            legs.push_back(entries[bestEntry].leg(graph, end.point));
+        }
+    } else if (best == std::numeric_limits<double>::infinity()) {
+        return result;
     }
-    distances[startNodeId] = 0.0;
 
-    pq.push({startNodeId, 0.0});
+    const int startName = graph.edgeRoadNameId(start.edge);
+    result.steps = describeLegs(graph,
+                                startName > 0 ? "Start on " + graph.nameTable().at(startName) : QString("Start"),
+                                start.point, legs, QString());
+    return result;
+}
+
+RouteResult Router::route(const RouteQuery& query) const
+{
+    RouteResult result;
+
+    // Held for the whole query, so a concurrent setGraph cannot free it
+    StatePtr routing = currentState();
+    const RoadGraph& graph = routing->snapshot->graph();
+
+    if (!graph.hasNode(query.startNodeId) || !graph.hasNode(query.endNodeId) ||
+        query.startNodeId == query.endNodeId) {
+        return result;
+    }
 
-    while (!pq.empty()) {
-        State current = pq.top();
-        pq.pop();
+    const auto& hierarchy = routing->hierarchies[static_cast<int>(query.metric)];
 
-        if (current.nodeId == endNodeId) {
+    std::vector<int> path;
+    switch (query.mode) {
+    case RoutingMode::ContractionHierarchy:
+        if (hierarchy) {
+            path = hierarchy->findPath(query.startNodeId, query.endNodeId, &result.stats,
+                                       query.heapKind, query.control);
             break;
         }
+        // fall through
+    case RoutingMode::Bidirectional:
+        path = bidirectionalSearch(*routing, query, result.stats);
+        break;
+    default:
+        path = unidirectionalSearch(*routing, query, result.stats);
+        break;
+    }
+
+    result.cancelled = query.control && query.control->cancelled.load();
+    if (!result.cancelled) {
+        result.steps = buildRoute(graph, path, query.metric);
+    }
+    return result;
+}
+
+quint64 Router::findRouteAsync(int startNodeId, int endNodeId)
+{
+    const RouteQuery query = makeQuery(startNodeId, endNodeId);
+    return startRequest([this, query](QueryControl* control) {
+        // A missing hierarchy or landmarks take far longer to build than the
+        // search itself, so they are built here where they can be cancelled
+        RouteQuery own = query;
+        own.control = control;
+        RouteResult result;
+        if (prepare(own.mode, own.metric, control)) {
+            result = route(own);
+        } else {
+            result.cancelled = true;
+        }
+        return result;
+    });
+}
+
+quint64 Router::findRouteAsync(const GeoCoord& from, const GeoCoord& to)
+{
+    const RouteMetric routeMetric = metric;
+    const HeapKind kind = queueKind;
+    return startRequest([this, from, to, routeMetric, kind](QueryControl* control) {
+        return routeBetween(from, to, routeMetric, kind, control);
+    });
+}
+
+quint64 Router::startRequest(const std::function<RouteResult(QueryControl*)>& run)
+{
+    cancelRoute();
+
+    auto control = std::make_shared<QueryControl>();
+    activeControl = control;
+    const quint64 requestId = ++lastRequestId;
+
+    auto* watcher = new QFutureWatcher<RouteResult>(this);
+    connect(watcher, &QFutureWatcher<RouteResult>::finished, this, [this, watcher, control]() {
+        RouteResult result = watcher->result();
+        watcher->deleteLater();
+
+        if (activeControl == control) {
+            activeControl.reset();
+            stats = result.stats;
+        }
+        emit routeFinished(result);
+    });
+
+    // The lambda owns a reference to the control block, so it stays valid
+    // even after a newer request replaces it
+    watcher->setFuture(QtConcurrent::run(&workers, [run, control, requestId]() {
+        RouteResult result = run(control.get());
+        result.requestId = requestId;
+        return result;
+    }));
+
+    return requestId;
+}
+
+void Router::cancelRoute()
+{
+    if (activeControl) {
+        activeControl->cancelled = true;
+        activeControl.reset();
+    }
+}
+
+int Router::routingProgress() const
+{
+    return activeControl ? activeControl->settledNodes.load() : 0;
+}
+
+DistanceMatrix Router::distanceMatrix(const std::vector<int>& sources,
+                                     const std::vector<int>& targets, RouteMetric m)
+{
+    prepare(RoutingMode::ContractionHierarchy, m);
+    StatePtr routing = currentState();
+    const auto& hierarchy = routing->hierarchies[static_cast<int>(m)];
+    if (!hierarchy) {
+        // The graph was replaced while the hierarchy was being built
+        return DistanceMatrix();
+    }
+    return hierarchy->distanceTable(sources, targets, queueKind);
+}
+
+std::vector<Isochrone> Router::isochrones(int origin, const std::vector<double>& budgets,
+                                          QueryStats* queryStats) const
+{
+    return reachableAreas(*graphSnapshot(), queueKind, origin, budgets, queryStats);
+}
+
+QFuture<std::vector<Isochrone>> Router::isochronesAsync(int origin, const std::vector<double>& budgets)
+{
+    // The snapshot is held until the search ends, whatever setGraph does
+    GraphSnapshotPtr snapshot = graphSnapshot();
+    const HeapKind kind = queueKind;
+    return QtConcurrent::run(&workers, [snapshot, kind, origin, budgets]() {
+        return reachableAreas(*snapshot, kind, origin, budgets, nullptr);
+    });
+}
+
+std::vector<Isochrone> Router::reachableAreas(const GraphSnapshot& snapshot, HeapKind kind, int origin,
+                                              const std::vector<double>& budgets, QueryStats* queryStats)
+{
+    QueryStats unused;
+    QueryStats& counts = queryStats ? *queryStats : unused;
+    counts = QueryStats();
+    const RoadGraph& graph = snapshot.graph();
+
+    std::vector<Isochrone> result(budgets.size());
+    for (size_t k = 0; k < budgets.size(); k++) {
+        result[k].budget = budgets[k];
+    }
+    if (!graph.hasNode(origin) || budgets.empty()) {
+        return result;
+    }
+    const double maxBudget = *std::max_element(budgets.begin(), budgets.end());
+
+    QueryWorkspace& ws = QueryWorkspace::local();
+    ws.startQuery(graph.nodeCount(), kind);
+    ws.setDistance(origin, 0.0);
+    ws.push(origin, 0.0, 0.0);
 
-        if (current.cost > distances[current.nodeId]) {
+    while (!ws.empty()) {
+        QueryWorkspace::HeapEntry current = ws.top();
+        ws.pop();
+
+        const int u = current.node;
+        if (current.cost > ws.distance(u)) {
             continue;
         }
+        // Settled in order of time, so nothing later fits any budget
+        if (current.cost > maxBudget) {
+            break;
+        }
+        counts.settledNodes++;
 
-        if (graph.find(current.nodeId) != graph.end()) {
-            for (const auto& edge : graph.at(current.nodeId)) {
-                double newCost = current.cost + edge.distance;
+        for (size_t k = 0; k < budgets.size(); k++) {
+            if (current.cost <= budgets[k]) {
+                result[k].nodes.push_back(u);
+            }
+        }
+
+        const GeoCoord from = graph.coord(u);
+        for (int e = graph.edgeBegin(u); e < graph.edgeEnd(u); e++) {
+            const int next = graph.edgeTarget(e);
+            const double time = graph.edgeTravelTime(e);
+            const double newCost = current.cost + time;
+            counts.relaxedEdges++;
 
-                if (newCost < distances[edge.toNode]) {
-                    distances[edge.toNode] = newCost;
-                    previous[edge.toNode] = current.nodeId;
-                    pq.push({edge.toNode, newCost});
+            // Budgets that run out somewhere along this edge
+            for (size_t k = 0; k < budgets.size(); k++) {
+                if (current.cost <= budgets[k] && newCost > budgets[k]) {
+                    const double fraction = (budgets[k] - current.cost) / time;
+                    const GeoCoord to = graph.coord(next);
+                    GeoCoord cut(from.lat + (to.lat - from.lat) * fraction,
+                                 from.lon + (to.lon - from.lon) * fraction);
+                    result[k].partialEdges.push_back({e, u, fraction, cut});
                 }
             }
+
+            if (newCost <= maxBudget && newCost < ws.distance(next)) {
+                ws.setDistance(next, newCost, u, e);
+                ws.push(next, newCost, newCost);
+            }
+        }
+    }
+
+    // Outline each area around its nodes and the ends of its partial edges,
+    // digging in no finer than a fiftieth of the area's extent
+    for (Isochrone& iso : result) {
+        std::vector<GeoCoord> points;
+        for (int node : iso.nodes) {
+            points.push_back(graph.coord(node));
+        }
+        for (const PartialEdge& partial : iso.partialEdges) {
+            points.push_back(partial.cutPoint);
+        }
+        if (points.empty()) {
+            continue;
+        }
+
+        double extent = 0.0;
+        for (const GeoCoord& point : points) {
+            extent = std::max(extent, point.distanceTo(graph.coord(origin)));
         }
+        iso.polygon = concaveHull(points, 2.0, extent / 50.0);
+    }
+
+    return result;
+}
+
+std::vector<int> Router::unidirectionalSearch(const State& routing, const RouteQuery& query,
+                                              QueryStats& queryStats) const
+{
+    const RoadGraph& graph = routing.snapshot->graph();
+    const int startNodeId = query.startNodeId;
+    const int endNodeId = query.endNodeId;
+
+    // ALT only consults the few landmarks that bound this query best
+    std::vector<int> activeLandmarks;
+    const auto& landmarks = routing.landmarkIndexes[static_cast<int>(query.metric)];
+    if (query.mode == RoutingMode::ALT && landmarks) {
+        activeLandmarks = landmarks->selectActive(startNodeId, endNodeId, ActiveLandmarkCount);
     }
 
-    if (previous.find(endNodeId) == previous.end()) {
-        return route;
+    QueryWorkspace& ws = QueryWorkspace::local();
+    ws.startQuery(graph.nodeCount(), query.heapKind);
+
+    ws.setDistance(startNodeId, 0.0);
+    ws.push(startNodeId, 0.0, lowerBound(routing, query, startNodeId, activeLandmarks));
+
+    while (!ws.empty()) {
+        QueryWorkspace::HeapEntry current = ws.top();
+        ws.pop();
+
+        if (current.cost > ws.distance(current.node)) {
+            continue;
+        }
+
+        queryStats.settledNodes++;
+        if (query.control && query.control->poll(queryStats.settledNodes)) {
+            return {};
+        }
+
+        if (current.node == endNodeId) {
+            break;
+        }
+
+        for (int e = graph.edgeBegin(current.node); e < graph.edgeEnd(current.node); e++) {
+            int next = graph.edgeTarget(e);
+            double newCost = current.cost + graph.edgeCost(e, query.metric);
+            queryStats.relaxedEdges++;
+
+            if (newCost < ws.distance(next)) {
+                ws.setDistance(next, newCost, current.node, e);
+                ws.push(next, newCost, newCost + lowerBound(routing, query, next, activeLandmarks));
+            }
+        }
     }
 
     std::vector<int> path;
-    int current = endNodeId;
-    while (current != startNodeId) {
+    if (!ws.isReached(endNodeId)) {
+        return path;
+    }
+
+    for (int current = endNodeId; current >= 0; current = ws.parent(current)) {
         path.push_back(current);
-        current = previous[current];
     }
-    path.push_back(startNodeId);
     std::reverse(path.begin(), path.end());
 
-    for (size_t i = 0; i < path.size(); i++) {
-        RouteStep step;
-        step.location = nodes[path[i]].coord;
+    return path;
+}
 
-        if (i == 0) {
-            step.instruction = "Start at " + nodes[path[i]].name;
-            step.distance = 0;
-        } else {
-            double dist = nodes[path[i-1]].coord.distanceTo(nodes[path[i]].coord);
-            step.distance = dist;
-            step.instruction = QString("Continue to %1 (%2 m)")
-                                   .arg(nodes[path[i]].name).arg(static_cast<int>(dist));
+std::vector<int> Router::bidirectionalSearch(const State& routing, const RouteQuery& query,
+                                             QueryStats& queryStats) const
+{
+    const RoadGraph& graph = routing.snapshot->graph();
+    const ReverseIndex& reverse = routing.snapshot->reverse();
+    const int startNodeId = query.startNodeId;
+    const int endNodeId = query.endNodeId;
+
+    // Slot 0 is the forward search from the start, 1 the backward search
+    // from the end over reversed edges. For the backward side the parent
+    // is the next node on the way to the end.
+    QueryWorkspace* ws[2] = {&QueryWorkspace::local(0), &QueryWorkspace::local(1)};
+    ws[0]->startQuery(graph.nodeCount(), query.heapKind);
+    ws[1]->startQuery(graph.nodeCount(), query.heapKind);
+
+    ws[0]->setDistance(startNodeId, 0.0);
+    ws[1]->setDistance(endNodeId, 0.0);
+    ws[0]->push(startNodeId, 0.0, 0.0);
+    ws[1]->push(endNodeId, 0.0, 0.0);
+
+    double best = std::numeric_limits<double>::infinity();
+    int meetingNode = -1;
+
+    while (true) {
+        // Drop stale entries so both tops are real tentative distances
+        for (int side = 0; side < 2; side++) {
+            while (!ws[side]->empty() &&
+                   ws[side]->top().cost > ws[side]->distance(ws[side]->top().node)) {
+                ws[side]->pop();
+            }
+        }
+        if (ws[0]->empty() || ws[1]->empty()) {
+            break;
         }
 
-        route.push_back(step);
+        // Every undiscovered path is at least as long as the two tops
+        // together, so once they reach the best meeting point it is optimal
+        if (ws[0]->top().cost + ws[1]->top().cost >= best) {
+            break;
+        }
+
+        const int side = ws[0]->top().cost <= ws[1]->top().cost ? 0 : 1;
+        QueryWorkspace& own = *ws[side];
+        const QueryWorkspace& other = *ws[1 - side];
+        QueryWorkspace::HeapEntry current = own.top();
+        own.pop();
+        queryStats.settledNodes++;
+        if (query.control && query.control->poll(queryStats.settledNodes)) {
+            return {};
+        }
+
+        const int begin = side == 0 ? graph.edgeBegin(current.node)
+                                    : reverse.firstEdge[current.node];
+        const int end = side == 0 ? graph.edgeEnd(current.node)
+                                  : reverse.firstEdge[current.node + 1];
+
+        for (int i = begin; i < end; i++) {
+            int next = side == 0 ? graph.edgeTarget(i) : reverse.sources[i];
+            int edge = side == 0 ? i : reverse.edgeIds[i];
+            double newCost = current.cost + graph.edgeCost(edge, query.metric);
+            queryStats.relaxedEdges++;
+
+            if (newCost < own.distance(next)) {
+                own.setDistance(next, newCost, current.node, edge);
+                own.push(next, newCost, newCost);
+            }
+
+            double through = own.distance(next) + other.distance(next);
+            if (through < best) {
+                best = through;
+                meetingNode = next;
+            }
+        }
     }
 
-    return route;
+    std::vector<int> path;
+    if (meetingNode < 0) {
+        return path;
+    }
+
+    for (int current = meetingNode; current >= 0; current = ws[0]->parent(current)) {
+        path.push_back(current);
+    }
+    std::reverse(path.begin(), path.end());
+
+    for (int current = ws[1]->parent(meetingNode); current >= 0; current = ws[1]->parent(current)) {
+        path.push_back(current);
+    }
+
+    return path;
+}
+
+std::vector<RouteStep> Router::buildRoute(const RoadGraph& graph, const std::vector<int>& path,
+                                          RouteMetric routeMetric) const
+{
+    if (path.empty()) {
+        return std::vector<RouteStep>();
+    }
+    return describeLegs(graph, "Start at " + graph.nodeName(path[0]), graph.coord(path[0]),
+                        pathLegs(graph, path, routeMetric),
+                        graph.hasName(path.back()) ? graph.nodeName(path.back()) : QString());
 }
@@ -2,32 +2,195 @@
 #define ROUTER_H
 
 #include <QObject>
+#include <QFuture>
+#include <QMutex>
+#include <QThreadPool>
+#include <functional>
 #include <vector>
-#include <queue>
+#include <memory>
 #include "datatypes.h"
+#include "roadgraph.h"
+#include "graphsnapshot.h"
+#include "contractionhierarchy.h"
+#include "landmarks.h"
+#include "queryworkspace.h"
+#include "isochrone.h"
+
+// Search strategy used by Router::findRoute
+enum class RoutingMode {
+    Dijkstra,               // Uninformed, settles every node closer than the target
+    AStar,                  // Goal-directed with a straight-line lower bound
+    Bidirectional,          // Forward and backward Dijkstra meeting in the middle
+    ContractionHierarchy,   // Upward bidirectional search over a preprocessed hierarchy
+    ALT                     // A* with landmark triangle-inequality bounds
+};
+
+// One route request, self-contained so that it can run on any thread
+struct RouteQuery {
+    int startNodeId = -1;
+    int endNodeId = -1;
+    RoutingMode mode = RoutingMode::Dijkstra;
+    RouteMetric metric = RouteMetric::Distance;
+    HeapKind heapKind = HeapKind::FourAry;
+    QueryControl* control = nullptr;    // Optional cancellation and progress
+};
+
+struct RouteResult {
+    quint64 requestId = 0;      // Set for asynchronous requests
+    std::vector<RouteStep> steps;
+    QueryStats stats;
+    bool cancelled = false;
+};
 
 class Router : public QObject {
     Q_OBJECT
 
 public:
     explicit Router(QObject *parent = nullptr);
+    ~Router();
 
-    void setGraph(const AdjacencyList& g, const std::vector<Node>& n);
+    // Publishes a new graph atomically. Queries already running, including
+    // asynchronous ones, finish against the snapshot they started with.
+    // Hierarchies and landmarks are rebuilt on their next use.
+    void setGraph(const GraphSnapshotPtr& snapshot);
+    GraphSnapshotPtr graphSnapshot() const;
     std::vector<RouteStep> findRoute(int startNodeId, int endNodeId);
+    // Route between arbitrary positions, each snapped onto its nearest road.
+    // It leaves the start along its road either way the road runs and joins
+    // the end's road the same way, so it includes the part roads at both ends.
+    std::vector<RouteStep> findRoute(const GeoCoord& from, const GeoCoord& to);
+    // The read-only search behind it, always Dijkstra: hierarchies and
+    // landmarks only know whole nodes, not points along an edge
+    RouteResult routeBetween(const GeoCoord& from, const GeoCoord& to, RouteMetric routeMetric,
+                             HeapKind kind, QueryControl* control = nullptr) const;
+
+    // Builds what a mode needs for a metric, such as the hierarchy or the
+    // landmarks, so that route() never has to modify the router. Callable
+    // from any thread; builds run one at a time. Returns false when
+    // cancelled through control, which also receives the progress.
+    bool prepare(RoutingMode m, RouteMetric routeMetric, QueryControl* control = nullptr);
+    // Runs prepare on the worker pool and reports through prepareFinished
+    // unless a newer call cancelled it. A contraction hierarchy is first
+    // looked for in cachePath, when given, and saved there once built.
+    void prepareAsync(RoutingMode m, RouteMetric routeMetric, const QString& cachePath = QString());
+    // A query using the current mode, metric and heap
+    RouteQuery makeQuery(int startNodeId, int endNodeId) const;
+    // Read-only, so any number of threads may run queries at once, also
+    // while the graph is being replaced. Without preparation CH falls back
+    // to bidirectional Dijkstra and ALT to plain Dijkstra.
+    RouteResult route(const RouteQuery& query) const;
+
+    // Runs findRoute, preparation included, on the router's worker pool and
+    // reports through routeFinished, cancelled or not. A new request cancels
+    // the one in flight. Returns the request id.
+    quint64 findRouteAsync(int startNodeId, int endNodeId);
+    // The same for findRoute between positions
+    quint64 findRouteAsync(const GeoCoord& from, const GeoCoord& to);
+    void cancelRoute();
+    bool isRouting() const { return activeControl != nullptr; }
+    // Nodes settled so far by the active request
+    int routingProgress() const;
+
+    // Costs between all source/target pairs without building any routes.
+    // Runs on the contraction hierarchy of the given metric, building it
+    // first if needed, independently of the routing mode.
+    DistanceMatrix distanceMatrix(const std::vector<int>& sources, const std::vector<int>& targets,
+                                  RouteMetric m);
+    // Areas reachable from origin within each travel time budget (seconds),
+    // whatever the current metric. One search bounded by the largest budget
+    // serves all of them; results follow the order of budgets. Read-only, and
+    // the search's counts go to queryStats when given, not lastQueryStats().
+    std::vector<Isochrone> isochrones(int origin, const std::vector<double>& budgets,
+                                      QueryStats* queryStats = nullptr) const;
+    // The same on the router's worker pool, for the graph and heap current
+    // at the time of the call
+    QFuture<std::vector<Isochrone>> isochronesAsync(int origin, const std::vector<double>& budgets);
     GeoCoord getNodeCoord(int nodeId) const;
+    // Nearest point on any road; the edge is -1 when the graph has none
+    EdgeSnap snapToRoad(const GeoCoord& coord) const;
+
+    void setRoutingMode(RoutingMode m) { mode = m; }
+    RoutingMode routingMode() const { return mode; }
+    void setMetric(RouteMetric m) { metric = m; }
+    RouteMetric routeMetric() const { return metric; }
+    // Priority queue used by every search mode
+    void setHeapKind(HeapKind kind) { queueKind = kind; }
+    HeapKind heapKind() const { return queueKind; }
+
+    const QueryStats& lastQueryStats() const { return stats; }
+
+    // Contraction hierarchies are built per metric; a route query in
+    // ContractionHierarchy mode builds the missing one on first use.
+    void buildContractionHierarchy();
+    bool hasContractionHierarchy() const;
+    bool saveContractionHierarchy(const QString& path) const;
+    bool loadContractionHierarchy(const QString& path);
+    int contractionShortcutCount() const;
+
+    // Landmark tables for ALT, also per metric and built on first use
+    void buildLandmarks(int count = 16, LandmarkSelection selection = LandmarkSelection::Avoid);
+    bool hasLandmarks() const;
+
+signals:
+    void routeFinished(const RouteResult& result);
+    // fromCache is set when the hierarchy was loaded rather than built
+    void prepareFinished(RoutingMode m, RouteMetric routeMetric, bool fromCache);
 
 private:
+    // Everything a query reads, published as one unit and never modified
+    // afterwards. Building a hierarchy or landmarks publishes a new state
+    // sharing the unchanged parts, so readers only ever see whole states.
+    // Any thread may publish while holding publishLock.
     struct State {
-        int nodeId;
-        double cost;
-
-        bool operator>(const State& other) const {
-            return cost > other.cost;
-        }
+        GraphSnapshotPtr snapshot;
+        // Indexed by RouteMetric, null until built
+        std::shared_ptr<const ContractionHierarchy> hierarchies[2];
+        std::shared_ptr<const LandmarkIndex> landmarkIndexes[2];
+        // Landmarks of an earlier graph. prepare() keeps their choice, and
+        // only recomputes the tables, when the nodes turn out unchanged.
+        std::shared_ptr<const LandmarkIndex> previousLandmarks[2];
     };
+    using StatePtr = std::shared_ptr<const State>;
+
+    StatePtr currentState() const;
+    void publish(const StatePtr& next);
+    // Adds a hierarchy or landmarks built for builtFor to the current state.
+    // Returns false, publishing nothing, once the graph has been replaced.
+    bool install(const GraphSnapshotPtr& builtFor, RouteMetric routeMetric,
+                 const std::shared_ptr<const ContractionHierarchy>& hierarchy,
+                 const std::shared_ptr<const LandmarkIndex>& landmarks);
+
+    // Runs a request on the worker pool, cancelling the one in flight
+    quint64 startRequest(const std::function<RouteResult(QueryControl*)>& run);
+
+    static std::vector<Isochrone> reachableAreas(const GraphSnapshot& snapshot, HeapKind kind, int origin,
+                                                 const std::vector<double>& budgets,
+                                                 QueryStats* queryStats);
+
+    double lowerBound(const State& routing, const RouteQuery& query, int nodeId,
+                      const std::vector<int>& activeLandmarks) const;
+    std::vector<int> unidirectionalSearch(const State& routing, const RouteQuery& query,
+                                          QueryStats& queryStats) const;
+    std::vector<int> bidirectionalSearch(const State& routing, const RouteQuery& query,
+                                         QueryStats& queryStats) const;
+    // One step per run of edges on the same road, measured by the stored
+    // lengths of the edges the search took under the given metric
+    std::vector<RouteStep> buildRoute(const RoadGraph& graph, const std::vector<int>& path,
+                                      RouteMetric routeMetric) const;
+
+    StatePtr state;
+    QMutex publishLock;
+    QMutex prepareLock;
+
+    RoutingMode mode;
+    RouteMetric metric;
+    HeapKind queueKind;
+    QueryStats stats;
 
-    AdjacencyList graph;
-    std::vector<Node> nodes;
+    QThreadPool workers;
+    std::shared_ptr<QueryControl> activeControl;
+    std::shared_ptr<QueryControl> prepareControl;
+    quint64 lastRequestId;
 };
 
 #endif // ROUTER_H
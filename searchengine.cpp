@@ -1,90 +1,82 @@
 #include "searchengine.h"
+#include <cstring>
+#include <algorithm>
 
 SearchEngine::SearchEngine(QObject *parent)
-    : QObject(parent), root(new TrieNode())
+    : QObject(parent)
 {
 }
 
-SearchEngine::~SearchEngine()
+void SearchEngine::setGraph(const GraphSnapshotPtr& g)
 {
-    delete root;
+    snapshot = g;
 }
 
-void SearchEngine::buildIndex(const std::vector<Node>& nodes)
+int SearchEngine::lowerBound(const QByteArray& key) const
 {
-    for (const auto& node : nodes) {
-        if (!node.name.isEmpty()) {
-            insert(node.name.toLower(), node.id);
-            nameToId[node.name] = node.id;
+    const StringTable& keys = snapshot->graph().searchKeys();
+
+    int low = 0;
+    int high = keys.size();
+    while (low < high) {
+        int mid = (low + high) / 2;
+        const int size = keys.utf8Size(mid);
+        const int common = std::min(size, static_cast<int>(key.size()));
+        const int order = std::memcmp(keys.utf8(mid), key.constData(), common);
+        if (order < 0 || (order == 0 && size < key.size())) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
-}
-
-void SearchEngine::insert(const QString& word, int nodeId)
-{
-    TrieNode* current = root;
-
-    for (const QChar& ch : word) {
-        if (current->children.find(ch) == current->children.end()) {
-            current->children[ch] = new TrieNode();
-        }
-        current = current->children[ch];
-    }
-
-    current->isEndOfWord = true;
-    current->nodeId = nodeId;
+    return low;
 }
 
 std::vector<std::pair<int, QString>> SearchEngine::search(const QString& prefix, int maxResults)
 {
     std::vector<std::pair<int, QString>> results;
 
-    if (prefix.isEmpty()) {
+    if (prefix.isEmpty() || !snapshot) {
         return results;
     }
 
-    QString lowerPrefix = prefix.toLower();
-    TrieNode* current = root;
+    const RoadGraph& graph = snapshot->graph();
+    const StringTable& keys = graph.searchKeys();
+    const QByteArray key = prefix.toLower().toUtf8();
 
-    for (const QChar& ch : lowerPrefix) {
-        if (current->children.find(ch) == current->children.end()) {
-            return results;
+    // Keys sharing the prefix are adjacent; list each distinct key once
+    for (int i = lowerBound(key); i < keys.size() && static_cast<int>(results.size()) < maxResults; i++) {
+        if (keys.utf8Size(i) < key.size() || std::memcmp(keys.utf8(i), key.constData(), key.size()) != 0) {
+            break;
+        }
+        if (i > 0 && keys.utf8Size(i) == keys.utf8Size(i - 1) &&
+            std::memcmp(keys.utf8(i), keys.utf8(i - 1), keys.utf8Size(i)) == 0) {
+            continue;
         }
-        current = current->children[ch];
+        const int nodeId = graph.searchNode(i);
+        results.push_back({nodeId, graph.nodeName(nodeId)});
     }
 
-    findAllWords(current, lowerPrefix, results, maxResults);
-
     return results;
 }
 
-void SearchEngine::findAllWords(TrieNode* node, QString prefix,
-                                std::vector<std::pair<int, QString>>& results,
-                                int maxResults)
+int SearchEngine::getNodeId(const QString& name)
 {
-    if (results.size() >= static_cast<size_t>(maxResults)) {
-        return;
+    if (name.isEmpty() || !snapshot) {
+        return -1;
     }
 
-    if (node->isEndOfWord) {
-        for (const auto& pair : nameToId) {
-            if (pair.first.toLower() == prefix) {
-                results.push_back({node->nodeId, pair.first});
-                break;
-            }
-        }
-    }
-
-    for (auto& pair : node->children) {
-        findAllWords(pair.second, prefix + pair.first, results, maxResults);
-    }
-}
+    const RoadGraph& graph = snapshot->graph();
+    const StringTable& keys = graph.searchKeys();
+    const QByteArray key = name.toLower().toUtf8();
 
-int SearchEngine::getNodeId(const QString& name)
-{
-    auto it = nameToId.find(name);
-    if (it != nameToId.end()) {
-        return it->second;
+    for (int i = lowerBound(key); i < keys.size(); i++) {
+        if (keys.utf8Size(i) != key.size() || std::memcmp(keys.utf8(i), key.constData(), key.size()) != 0) {
+            break;
+        }
+        if (graph.nodeName(graph.searchNode(i)) == name) {
+            return graph.searchNode(i);
+        }
     }
     return -1;
 }
@@ -4,25 +4,26 @@
 #include <QObject>
 #include <vector>
 #include "datatypes.h"
+#include "graphsnapshot.h"
 
+// Prefix search over place names. Queries run directly on the sorted name
+// keys stored in the graph, so a mapped graph file is searched in place.
 class SearchEngine : public QObject {
     Q_OBJECT
 
 public:
     explicit SearchEngine(QObject *parent = nullptr);
-    ~SearchEngine();
 
-    void buildIndex(const std::vector<Node>& nodes);
+    // Searches this snapshot from now on; keeps it alive until replaced
+    void setGraph(const GraphSnapshotPtr& snapshot);
     std::vector<std::pair<int, QString>> search(const QString& prefix, int maxResults = 10);
     int getNodeId(const QString& name);
 
 private:
-    void insert(const QString& word, int nodeId);
-    void findAllWords(TrieNode* node, QString prefix,
-                      std::vector<std::pair<int, QString>>& results, int maxResults);
+    // First search key not ordered before key
+    int lowerBound(const QByteArray& key) const;
 
-    TrieNode* root;
-    std::unordered_map<QString, int> nameToId;
+    GraphSnapshotPtr snapshot;
 };
 
 #endif // SEARCHENGINE_H
@@ -0,0 +1,349 @@
+#include "spatialindex.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+const double EarthRadius = 6371000.0;
+const double Infinity = std::numeric_limits<double>::infinity();
+
+// Counting sort of (cell, item) pairs into CSR form. forEach(add) must call
+// add(cell, item) for every pair, the same way both times it is called.
+template <typename ForEach>
+void fillGrid(int cellCount, std::vector<int>& first, std::vector<int>& items, ForEach forEach)
+{
+    first.assign(cellCount + 1, 0);
+    forEach([&first](int cell, int) { first[cell + 1]++; });
+    std::partial_sum(first.begin(), first.end(), first.begin());
+
+    items.resize(first.back());
+    std::vector<int> next(first.begin(), first.end() - 1);
+    forEach([&next, &items](int cell, int item) { items[next[cell]++] = item; });
+}
+
+} // namespace
+
+SpatialIndex::SpatialIndex()
+    : metersPerLat(0.0),
+    metersPerLon(0.0),
+    cellSize(1.0),
+    columns(0),
+    rows(0)
+{
+}
+
+SpatialIndex::Point SpatialIndex::project(const GeoCoord& coord) const
+{
+    return {(coord.lon - origin.lon) * metersPerLon, (coord.lat - origin.lat) * metersPerLat};
+}
+
+GeoCoord SpatialIndex::unproject(const Point& point) const
+{
+    return GeoCoord(origin.lat + point.y / metersPerLat, origin.lon + point.x / metersPerLon);
+}
+
+int SpatialIndex::column(double x) const
+{
+    return static_cast<int>(std::min(std::max(std::floor(x / cellSize), 0.0), columns - 1.0));
+}
+
+int SpatialIndex::row(double y) const
+{
+    return static_cast<int>(std::min(std::max(std::floor(y / cellSize), 0.0), rows - 1.0));
+}
+
+template <typename Visit>
+void SpatialIndex::forEachCellOn(const Point& a, const Point& b, Visit visit) const
+{
+    int x = column(a.x);
+    int y = row(a.y);
+    const int endX = column(b.x);
+    const int endY = row(b.y);
+    visit(x, y);
+
+    // Walk the cell boundaries the segment crosses, nearest first
+    const double dx = b.x - a.x;
+    const double dy = b.y - a.y;
+    const int stepX = dx > 0 ? 1 : -1;
+    const int stepY = dy > 0 ? 1 : -1;
+    const double deltaX = dx != 0.0 ? cellSize / std::abs(dx) : Infinity;
+    const double deltaY = dy != 0.0 ? cellSize / std::abs(dy) : Infinity;
+    double nextX = dx != 0.0 ? ((x + (dx > 0 ? 1 : 0)) * cellSize - a.x) / dx : Infinity;
+    double nextY = dy != 0.0 ? ((y + (dy > 0 ? 1 : 0)) * cellSize - a.y) / dy : Infinity;
+
+    for (int steps = std::abs(endX - x) + std::abs(endY - y); steps > 0; steps--) {
+        if (y == endY || (x != endX && nextX < nextY)) {
+            x += stepX;
+            nextX += deltaX;
+        } else {
+            y += stepY;
+            nextY += deltaY;
+        }
+        visit(x, y);
+    }
+}
+
+template <typename Visit, typename Best>
+void SpatialIndex::scanRings(const Grid& grid, const Point& point, Visit visit, Best best) const
+{
+    if (columns == 0) {
+        return;
+    }
+
+    const int centerX = column(point.x);
+    const int centerY = row(point.y);
+
+    for (int ring = 0;; ring++) {
+        for (int y = std::max(centerY - ring, 0); y <= std::min(centerY + ring, rows - 1); y++) {
+            // Rows inside the ring only contribute their two end cells
+            const bool fullRow = y == centerY - ring || y == centerY + ring;
+            const int step = fullRow ? 1 : 2 * ring;
+            for (int x = centerX - ring; x <= centerX + ring; x += step) {
+                if (x < 0 || x >= columns) {
+                    continue;
+                }
+                const int cell = y * columns + x;
+                for (int i = grid.first[cell]; i < grid.first[cell + 1]; i++) {
+                    visit(grid.items[i]);
+                }
+            }
+        }
+
+        // Distance to the nearest cell outside the rings scanned so far
+        double gap = Infinity;
+        if (centerX - ring > 0) {
+            gap = std::min(gap, point.x - (centerX - ring) * cellSize);
+        }
+        if (centerX + ring < columns - 1) {
+            gap = std::min(gap, (centerX + ring + 1) * cellSize - point.x);
+        }
+        if (centerY - ring > 0) {
+            gap = std::min(gap, point.y - (centerY - ring) * cellSize);
+        }
+        if (centerY + ring < rows - 1) {
+            gap = std::min(gap, (centerY + ring + 1) * cellSize - point.y);
+        }
+
+        if (gap == Infinity || best() <= gap) {
+            return;
+        }
+    }
+}
+
+SpatialIndex::SpatialIndex(const RoadGraph& graph)
+    : SpatialIndex()
+{
+    const int count = graph.nodeCount();
+    if (count == 0) {
+        return;
+    }
+
+    double minLat = graph.coord(0).lat, maxLat = minLat;
+    double minLon = graph.coord(0).lon, maxLon = minLon;
+    for (int u = 1; u < count; u++) {
+        const GeoCoord coord = graph.coord(u);
+        minLat = std::min(minLat, coord.lat);
+        maxLat = std::max(maxLat, coord.lat);
+        minLon = std::min(minLon, coord.lon);
+        maxLon = std::max(maxLon, coord.lon);
+    }
+
+    origin = GeoCoord(minLat, minLon);
+    metersPerLat = EarthRadius * M_PI / 180.0;
+    metersPerLon = metersPerLat * std::cos((minLat + maxLat) / 2.0 * M_PI / 180.0);
+
+    nodePoints.resize(count);
+    for (int u = 0; u < count; u++) {
+        nodePoints[u] = project(graph.coord(u));
+    }
+
+    // About two nodes per cell, and never many more cells than nodes even
+    // when the nodes lie along a line
+    const Point extent = project(GeoCoord(maxLat, maxLon));
+    const double width = std::max(extent.x, 1.0);
+    const double height = std::max(extent.y, 1.0);
+    cellSize = std::max(std::sqrt(width * height * 2.0 / count), 1.0);
+    while ((width / cellSize + 1) * (height / cellSize + 1) > 4.0 * count + 16) {
+        cellSize *= 2.0;
+    }
+    columns = static_cast<int>(width / cellSize) + 1;
+    rows = static_cast<int>(height / cellSize) + 1;
+
+    fillGrid(columns * rows, nodeGrid.first, nodeGrid.items, [this, count](auto add) {
+        for (int u = 0; u < count; u++) {
+            add(row(nodePoints[u].y) * columns + column(nodePoints[u].x), u);
+        }
+    });
+
+    // One direction of each two-way road is enough to find it
+    for (int u = 0; u < count; u++) {
+        for (int e = graph.edgeBegin(u); e < graph.edgeEnd(u); e++) {
+            const int v = graph.edgeTarget(e);
+            if (v == u) {
+                continue;
+            }
+            bool reversed = false;
+            if (v < u) {
+                for (int back = graph.edgeBegin(v); back < graph.edgeEnd(v) && !reversed; back++) {
+                    reversed = graph.edgeTarget(back) == u;
+                }
+            }
+            if (!reversed) {
+                segments.push_back({e, u, v});
+            }
+        }
+    }
+
+    fillGrid(columns * rows, segmentGrid.first, segmentGrid.items, [this](auto add) {
+        for (int i = 0; i < static_cast<int>(segments.size()); i++) {
+            forEachCellOn(nodePoints[segments[i].source], nodePoints[segments[i].target],
+                          [this, &add, i](int x, int y) { add(y * columns + x, i); });
+        }
+    });
+}
+
+int SpatialIndex::nearestNode(const GeoCoord& coord) const
+{
+    const Point point = project(coord);
+    int nearest = -1;
+    double nearestSquared = Infinity;
+
+    scanRings(nodeGrid, point, [&](int u) {
+        const double dx = nodePoints[u].x - point.x;
+        const double dy = nodePoints[u].y - point.y;
+        if (dx * dx + dy * dy < nearestSquared) {
+            nearestSquared = dx * dx + dy * dy;
+            nearest = u;
+        }
+    }, [&]() { return std::sqrt(nearestSquared); });
+
+    return nearest;
+}
+
+std::vector<int> SpatialIndex::nearestNodes(const GeoCoord& coord, int k) const
+{
+    std::vector<int> result;
+    if (k <= 0) {
+        return result;
+    }
+
+    // Max-heap on squared distance holding the k best so far
+    const Point point = project(coord);
+    std::vector<std::pair<double, int>> best;
+
+    scanRings(nodeGrid, point, [&](int u) {
+        const double dx = nodePoints[u].x - point.x;
+        const double dy = nodePoints[u].y - point.y;
+        const double squared = dx * dx + dy * dy;
+        if (static_cast<int>(best.size()) < k) {
+            best.emplace_back(squared, u);
+            std::push_heap(best.begin(), best.end());
+        } else if (squared < best.front().first) {
+            std::pop_heap(best.begin(), best.end());
+            best.back() = {squared, u};
+            std::push_heap(best.begin(), best.end());
+        }
+    }, [&]() {
+        return static_cast<int>(best.size()) < k ? Infinity : std::sqrt(best.front().first);
+    });
+
+    std::sort_heap(best.begin(), best.end());
+    result.reserve(best.size());
+    for (const auto& entry : best) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+std::vector<int> SpatialIndex::nodesWithin(const GeoCoord& coord, double meters) const
+{
+    std::vector<int> result;
+    if (columns == 0 || meters < 0.0) {
+        return result;
+    }
+
+    const Point point = project(coord);
+    const double squaredRadius = meters * meters;
+
+    for (int y = row(point.y - meters); y <= row(point.y + meters); y++) {
+        for (int x = column(point.x - meters); x <= column(point.x + meters); x++) {
+            const int cell = y * columns + x;
+            for (int i = nodeGrid.first[cell]; i < nodeGrid.first[cell + 1]; i++) {
+                const int u = nodeGrid.items[i];
+                const double dx = nodePoints[u].x - point.x;
+                const double dy = nodePoints[u].y - point.y;
+                if (dx * dx + dy * dy <= squaredRadius) {
+                    result.push_back(u);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<int> SpatialIndex::nodesInBox(const GeoCoord& corner1, const GeoCoord& corner2) const
+{
+    std::vector<int> result;
+    if (columns == 0) {
+        return result;
+    }
+
+    const Point a = project(corner1);
+    const Point b = project(corner2);
+    const double minX = std::min(a.x, b.x), maxX = std::max(a.x, b.x);
+    const double minY = std::min(a.y, b.y), maxY = std::max(a.y, b.y);
+
+    for (int y = row(minY); y <= row(maxY); y++) {
+        for (int x = column(minX); x <= column(maxX); x++) {
+            const int cell = y * columns + x;
+            for (int i = nodeGrid.first[cell]; i < nodeGrid.first[cell + 1]; i++) {
+                const Point& p = nodePoints[nodeGrid.items[i]];
+                if (p.x >= minX && p.x <= maxX && p.y >= minY && p.y <= maxY) {
+                    result.push_back(nodeGrid.items[i]);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+EdgeSnap SpatialIndex::nearestEdge(const GeoCoord& coord) const
+{
+    const Point point = project(coord);
+    EdgeSnap snap;
+    double nearestSquared = Infinity;
+    Point nearestPoint = point;
+
+    scanRings(segmentGrid, point, [&](int i) {
+        const RoadSegment& segment = segments[i];
+        const Point& a = nodePoints[segment.source];
+        const Point& b = nodePoints[segment.target];
+
+        const double dx = b.x - a.x;
+        const double dy = b.y - a.y;
+        const double lengthSquared = dx * dx + dy * dy;
+        double t = lengthSquared > 0.0
+                       ? ((point.x - a.x) * dx + (point.y - a.y) * dy) / lengthSquared
+                       : 0.0;
+        t = std::min(std::max(t, 0.0), 1.0);
+
+        const Point closest = {a.x + t * dx, a.y + t * dy};
+        const double squared = (closest.x - point.x) * (closest.x - point.x) +
+                               (closest.y - point.y) * (closest.y - point.y);
+        if (squared < nearestSquared) {
+            nearestSquared = squared;
+            nearestPoint = closest;
+            snap.edge = segment.edge;
+            snap.source = segment.source;
+            snap.target = segment.target;
+            snap.fraction = t;
+        }
+    }, [&]() { return std::sqrt(nearestSquared); });
+
+    if (snap.edge >= 0) {
+        snap.point = unproject(nearestPoint);
+        snap.distance = std::sqrt(nearestSquared);
+    }
+    return snap;
+}
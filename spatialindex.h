@@ -0,0 +1,94 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <vector>
+#include "datatypes.h"
+#include "roadgraph.h"
+
+// Closest point on a road segment to some query position
+struct EdgeSnap {
+    int edge = -1;          // -1 when the graph has no edges
+    int source = -1;
+    int target = -1;
+    double fraction = 0.0;  // Position along the edge, 0 at source, 1 at target
+    GeoCoord point;
+    double distance = 0.0;  // Meters from the query position
+
+    // End of the edge closer to the snapped point
+    int nearerNode() const { return fraction <= 0.5 ? source : target; }
+};
+
+// One indexed edge with its end nodes
+struct RoadSegment {
+    int edge;
+    int source;
+    int target;
+};
+
+// Nearest-neighbour queries over the nodes and road segments of a
+// RoadGraph, answered from uniform grids laid over a flat projection of the
+// graph's bounding box. Each node sits in one cell, each segment in every
+// cell it crosses; a query scans rings of cells around its position and
+// stops once no unvisited cell can hold anything closer.
+//
+// Distances are measured in the projection, which scales longitude by the
+// cosine of the box's middle latitude; over a city or region that is within
+// a fraction of a percent of the true distance. A road in both directions
+// is indexed once, under one of its two edges.
+class SpatialIndex {
+public:
+    SpatialIndex();
+    explicit SpatialIndex(const RoadGraph& graph);
+
+    // -1 when the graph has no nodes
+    int nearestNode(const GeoCoord& coord) const;
+    // Up to k nodes, nearest first
+    std::vector<int> nearestNodes(const GeoCoord& coord, int k) const;
+    // Nodes within meters of coord, in no particular order
+    std::vector<int> nodesWithin(const GeoCoord& coord, double meters) const;
+    EdgeSnap nearestEdge(const GeoCoord& coord) const;
+
+    // Nodes inside the box with the given corners, in no particular order
+    std::vector<int> nodesInBox(const GeoCoord& corner1, const GeoCoord& corner2) const;
+    // Every indexed segment, each road once, in increasing edge order
+    const std::vector<RoadSegment>& roadSegments() const { return segments; }
+
+private:
+    struct Point {
+        double x, y;
+    };
+
+    // Items per cell in CSR form: cell c holds items[first[c] .. first[c + 1])
+    struct Grid {
+        std::vector<int> first;
+        std::vector<int> items;
+    };
+
+    Point project(const GeoCoord& coord) const;
+    GeoCoord unproject(const Point& point) const;
+    int column(double x) const;
+    int row(double y) const;
+
+    // Calls visit(column, row) for every cell the segment a-b passes through
+    template <typename Visit>
+    void forEachCellOn(const Point& a, const Point& b, Visit visit) const;
+    // Calls visit(item) for every item in the rings of cells around point,
+    // nearest ring first, until visit's best distance so far is no greater
+    // than the distance to any cell not yet scanned
+    template <typename Visit, typename Best>
+    void scanRings(const Grid& grid, const Point& point, Visit visit, Best best) const;
+
+    GeoCoord origin;
+    double metersPerLat;
+    double metersPerLon;
+    double cellSize;        // Meters
+    int columns;
+    int rows;
+
+    std::vector<Point> nodePoints;
+    std::vector<RoadSegment> segments;
+    Grid nodeGrid;
+    Grid segmentGrid;       // Items index segments
+};
+
+#endif // SPATIALINDEX_H
@@ -1,6 +1,290 @@
 #include "tilemanager.h"
+#include <QMutexLocker>
+#include <QPainter>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+namespace {
+
+// Pixels a road is drawn beyond its centre line, at most
+const double RoadReach = 8.0;
+
+// Tiles at zoom that some road reaches into
+std::vector<TileCoord> tilesWithRoads(const RoadLayer& roads, int zoom)
+{
+    const double scale = TileManager::scaleForZoom(zoom);
+    const double margin = RoadReach / scale;
+    std::unordered_set<TileCoord> tiles;
+    std::vector<QLineF> lines;
+    for (int style = 0; style < RoadLayer::StyleCount; style++) {
+        roads.collect(static_cast<RoadLayer::Style>(style), roads.worldBounds(), scale, lines);
+        for (const QLineF& line : lines) {
+            const QRectF box = QRectF(line.p1(), line.p2()).normalized()
+                                   .adjusted(-margin, -margin, margin, margin);
+            for (const TileCoord& tile : TileManager::tilesIn(box, zoom)) {
+                tiles.insert(tile);
+            }
+        }
+    }
+    return std::vector<TileCoord>(tiles.begin(), tiles.end());
+}
+
+} // namespace
 
 TileManager::TileManager(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+    roads(std::make_shared<const RoadLayer>()),
+    pixelRatio(1.0),
+    cachedBytes(0),
+    cacheLimit(128LL * 1024 * 1024),
+    nextTicket(1)
+{
+    // Leave a core for the GUI thread
+    pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+}
+
+TileManager::~TileManager()
+{
+    {
+        QMutexLocker locker(&pendingLock);
+        pending.clear();
+    }
+    pool.clear();
+    pool.waitForDone();
+}
+
+void TileManager::setRoadLayer(const std::shared_ptr<const RoadLayer>& layer)
+{
+    roads = layer;
+    packPath.clear();
+    openPack();
+}
+
+void TileManager::setTilePack(const QString& path)
+{
+    if (path != packPath) {
+        packPath = path;
+        openPack();
+    }
+}
+
+void TileManager::setDevicePixelRatio(qreal ratio)
+{
+    if (ratio != pixelRatio) {
+        pixelRatio = ratio;
+        openPack();
+    }
+}
+
+void TileManager::setCacheLimit(qint64 bytes)
+{
+    cacheLimit = bytes;
+    evict();
+}
+
+int TileManager::zoomForScale(double scale)
+{
+    return static_cast<int>(std::ceil(std::log2(scale) + 10.0 - 1e-9));
+}
+
+double TileManager::scaleForZoom(int zoom)
+{
+    return std::ldexp(1.0, zoom - 10);
+}
+
+QRectF TileManager::worldRect(const TileCoord& tile)
+{
+    const double size = TileSize / scaleForZoom(tile.zoom);
+    return QRectF(tile.x * size, tile.y * size, size, size);
+}
+
+int TileManager::generate(const RoadLayer& roads, TilePack& pack, int firstZoom, int lastZoom)
+{
+    std::vector<TileCoord> missing;
+    for (int zoom = firstZoom; zoom <= lastZoom; zoom++) {
+        for (const TileCoord& tile : tilesWithRoads(roads, zoom)) {
+            if (!pack.contains(tile)) {
+                missing.push_back(tile);
+            }
+        }
+    }
+
+    const qreal ratio = pack.devicePixelRatio();
+    QtConcurrent::blockingMap(missing, [&roads, &pack, ratio](const TileCoord& tile) {
+        pack.write(tile, render(roads, tile, ratio));
+    });
+    pack.flush();
+    return static_cast<int>(missing.size());
+}
+
+std::vector<TileCoord> TileManager::tilesIn(const QRectF& worldRect, int zoom)
 {
+    const double size = TileSize / scaleForZoom(zoom);
+    const QRectF rect = worldRect.normalized();
+    const int firstX = static_cast<int>(std::floor(rect.left() / size));
+    const int lastX = static_cast<int>(std::floor(rect.right() / size));
+    const int firstY = static_cast<int>(std::floor(rect.top() / size));
+    const int lastY = static_cast<int>(std::floor(rect.bottom() / size));
+
+    std::vector<TileCoord> tiles;
+    for (int y = firstY; y <= lastY; y++) {
+        for (int x = firstX; x <= lastX; x++) {
+            tiles.emplace_back(x, y, zoom);
+        }
+    }
+    return tiles;
+}
+
+QImage TileManager::tile(const TileCoord& coord)
+{
+    auto it = cache.find(coord);
+    if (it == cache.end()) {
+        return QImage();
+    }
+    uses.splice(uses.begin(), uses, it->second.use);
+    return it->second.image;
+}
+
+void TileManager::request(const std::vector<TileCoord>& visible, const std::vector<TileCoord>& ahead)
+{
+    {
+        // Tiles a worker has started on are kept; the rest are requeued below
+        QMutexLocker locker(&pendingLock);
+        pool.clear();
+        for (auto it = pending.begin(); it != pending.end();) {
+            it = it->second.started ? std::next(it) : pending.erase(it);
+        }
+    }
+
+    for (const TileCoord& coord : visible) {
+        enqueue(coord, 1);
+    }
+    for (const TileCoord& coord : ahead) {
+        enqueue(coord, 0);
+    }
+}
+
+void TileManager::enqueue(const TileCoord& coord, int priority)
+{
+    if (cache.count(coord) > 0) {
+        return;
+    }
+
+    quint64 ticket;
+    {
+        QMutexLocker locker(&pendingLock);
+        if (pending.count(coord) > 0) {
+            return;
+        }
+        ticket = nextTicket++;
+        pending[coord] = Pending{ticket, false};
+    }
+
+    std::shared_ptr<const RoadLayer> layer = roads;
+    std::shared_ptr<TilePack> packed = pack;
+    const qreal ratio = pixelRatio;
+    pool.start([this, coord, ticket, layer, packed, ratio]() {
+        {
+            // Dropped or superseded while waiting in the queue
+            QMutexLocker locker(&pendingLock);
+            auto it = pending.find(coord);
+            if (it == pending.end() || it->second.ticket != ticket) {
+                return;
+            }
+            it->second.started = true;
+        }
+
+        QImage image = packed ? packed->read(coord) : QImage();
+        if (image.isNull()) {
+            image = render(*layer, coord, ratio);
+            if (packed) {
+                packed->write(coord, image);
+            }
+        }
+        QMetaObject::invokeMethod(this, [this, coord, ticket, image]() {
+            finished(coord, ticket, image);
+        }, Qt::QueuedConnection);
+    }, priority);
+}
+
+void TileManager::finished(const TileCoord& coord, quint64 ticket, const QImage& image)
+{
+    {
+        // Rendered for roads or a pixel ratio that have been replaced since
+        QMutexLocker locker(&pendingLock);
+        auto it = pending.find(coord);
+        if (it == pending.end() || it->second.ticket != ticket) {
+            return;
+        }
+        pending.erase(it);
+    }
+
+    uses.push_front(coord);
+    cache[coord] = Entry{image, uses.begin()};
+    cachedBytes += image.sizeInBytes();
+    evict();
+
+    emit tileReady(coord);
+}
+
+void TileManager::clear()
+{
+    {
+        QMutexLocker locker(&pendingLock);
+        pending.clear();
+    }
+    pool.clear();
+
+    cache.clear();
+    uses.clear();
+    cachedBytes = 0;
+}
+
+void TileManager::openPack()
+{
+    // Let the workers drop the old pack, which appends what it still holds
+    clear();
+    pool.waitForDone();
+    pack.reset();
+
+    if (!packPath.isEmpty()) {
+        auto opened = std::make_shared<TilePack>();
+        if (opened->open(TilePack::pathFor(packPath, pixelRatio), pixelRatio)) {
+            pack = opened;
+        }
+    }
+}
+
+void TileManager::evict()
+{
+    while (cachedBytes > cacheLimit && !uses.empty()) {
+        auto it = cache.find(uses.back());
+        cachedBytes -= it->second.image.sizeInBytes();
+        cache.erase(it);
+        uses.pop_back();
+    }
+}
+
+QImage TileManager::render(const RoadLayer& roads, const TileCoord& coord, qreal ratio)
+{
+    QImage image(QSize(TileSize, TileSize) * ratio, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(ratio);
+    image.fill(Qt::transparent);
+
+    const double scale = scaleForZoom(coord.zoom);
+    const QRectF area = worldRect(coord);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(scale, scale);
+    painter.translate(-area.topLeft());
+
+    // Roads just outside the tile still reach into it with their width
+    const double margin = RoadReach / scale;
+    roads.paint(painter, area.adjusted(-margin, -margin, margin, margin), scale);
+
+    return image;
 }
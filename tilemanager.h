@@ -2,12 +2,112 @@
 #define TILEMANAGER_H
 
 #include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QRectF>
+#include <QThreadPool>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "datatypes.h"
+#include "roadlayer.h"
+#include "tilepack.h"
 
+// Renders the road layer as square raster tiles on a thread pool and keeps
+// the most recently used ones in a cache bounded by memory.
+//
+// Tiles follow the map's world coordinates (see RoadLayer::toWorld). At
+// zoom z a tile is TileSize pixels across at scaleForZoom(z) pixels per
+// world unit, and tile (x, y) covers world x in [x, x + 1) * TileSize /
+// scaleForZoom(z), likewise for y. Tiles are transparent outside roads.
+//
+// With a tile pack set, tiles missing from the memory cache are read from
+// the pack before being rendered, and rendered ones are added to it.
+//
+// All members are called from the thread owning the manager; tileReady is
+// emitted there too.
 class TileManager : public QObject {
     Q_OBJECT
 
 public:
+    static const int TileSize = 256;
+
     explicit TileManager(QObject *parent = nullptr);
+    // Drops queued tiles and waits for those being rendered
+    ~TileManager();
+
+    // Replaces the roads to render, discarding every tile and the tile pack
+    void setRoadLayer(const std::shared_ptr<const RoadLayer>& roads);
+    // Keeps the tiles of the current roads in the pack at path across runs,
+    // or beside it for other pixel ratios (see TilePack::pathFor); an empty
+    // path stops using a pack
+    void setTilePack(const QString& path);
+    // Device pixels per tile pixel; a change discards every tile
+    void setDevicePixelRatio(qreal ratio);
+    // Least recently used tiles are evicted beyond this many bytes
+    void setCacheLimit(qint64 bytes);
+    qint64 cacheSize() const { return cachedBytes; }
+
+    // The coarsest zoom whose tiles are at least as detailed as scale
+    static int zoomForScale(double scale);
+    static double scaleForZoom(int zoom);
+    static QRectF worldRect(const TileCoord& tile);
+    // Tiles at zoom covering the world rectangle
+    static std::vector<TileCoord> tilesIn(const QRectF& worldRect, int zoom);
+
+    // Renders every tile with roads at zooms firstZoom to lastZoom that the
+    // pack lacks, at the pack's pixel ratio, on all cores. Blocks until they
+    // are appended and returns how many were rendered.
+    static int generate(const RoadLayer& roads, TilePack& pack, int firstZoom, int lastZoom);
+
+    // The cached tile, or a null image. Counts as a use for the LRU order.
+    QImage tile(const TileCoord& coord);
+    // Replaces the render queue: visible tiles first, then those expected
+    // next. Queued tiles in neither list are dropped; cached ones are skipped.
+    void request(const std::vector<TileCoord>& visible, const std::vector<TileCoord>& ahead);
+
+signals:
+    void tileReady(const TileCoord& tile);
+
+private:
+    struct Entry {
+        QImage image;
+        std::list<TileCoord>::iterator use;
+    };
+
+    struct Pending {
+        quint64 ticket;     // Of the latest request for the tile
+        bool started;       // A worker is rendering it
+    };
+
+    static QImage render(const RoadLayer& roads, const TileCoord& coord, qreal ratio);
+    void enqueue(const TileCoord& coord, int priority);
+    void finished(const TileCoord& coord, quint64 ticket, const QImage& image);
+    void clear();
+    void evict();
+    void openPack();
+
+    std::shared_ptr<const RoadLayer> roads;
+    qreal pixelRatio;
+
+    // Shared with the workers; replaced only once they are idle, so two
+    // packs never append to one file
+    std::shared_ptr<TilePack> pack;
+    QString packPath;
+
+    std::unordered_map<TileCoord, Entry> cache;
+    std::list<TileCoord> uses;          // Most recently used first
+    qint64 cachedBytes;
+    qint64 cacheLimit;
+
+    // Tiles queued or rendering. A worker renders, and its tile is cached,
+    // only while its ticket is still the current one.
+    QMutex pendingLock;
+    std::unordered_map<TileCoord, Pending> pending;
+    quint64 nextTicket;
+
+    QThreadPool pool;
 };
 
 #endif // TILEMANAGER_H
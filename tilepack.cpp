@@ -0,0 +1,273 @@
+#include "tilepack.h"
+#include <QBuffer>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <cstring>
+
+namespace {
+
+const quint32 FileMagic = 0x4B415054; // "TPAK"
+// Bump whenever tiles are drawn differently, so old packs are discarded
+const quint32 FileVersion = 2;
+
+// All fields little-endian
+struct FileHeader {
+    quint32 magic;
+    quint32 version;
+    double pixelRatio;
+};
+
+struct RecordHeader {
+    qint32 x;
+    qint32 y;
+    qint32 zoom;
+    quint32 length;     // Of the PNG blob that follows
+};
+
+QImage decode(const uchar* bytes, quint32 length, qreal ratio)
+{
+    QImage image = QImage::fromData(bytes, static_cast<int>(length), "PNG")
+                       .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(ratio);
+    return image;
+}
+
+} // namespace
+
+TilePack::TilePack()
+    : ratio(1.0),
+    data(nullptr),
+    mappedSize(0)
+{
+}
+
+TilePack::~TilePack()
+{
+    close();
+}
+
+QString TilePack::pathFor(const QString& path, qreal pixelRatio)
+{
+    if (pixelRatio == 1.0) {
+        return path;
+    }
+
+    const QFileInfo info(path);
+    const QString suffix = info.suffix().isEmpty() ? QString() : "." + info.suffix();
+    const QString base = path.left(path.size() - suffix.size());
+    return base + QString("@%1x").arg(pixelRatio) + suffix;
+}
+
+bool TilePack::open(const QString& path, qreal pixelRatio)
+{
+    close();
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(path);
+    Q_UNUSED(pixelRatio);
+    return false;
+#else
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    ratio = pixelRatio;
+
+    FileHeader header = {};
+    quint64 size = static_cast<quint64>(file.size());
+    const bool valid = size >= sizeof(header) &&
+                       file.read(reinterpret_cast<char*>(&header), sizeof(header)) == sizeof(header) &&
+                       header.magic == FileMagic && header.version == FileVersion;
+    if (valid && header.pixelRatio != ratio) {
+        // Someone else's tiles, which are worth keeping
+        close();
+        return false;
+    }
+    if (!valid) {
+        header = {FileMagic, FileVersion, ratio};
+        if (!file.resize(0) || !file.seek(0) ||
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header) ||
+            !file.flush()) {
+            close();
+            return false;
+        }
+        size = sizeof(header);
+    }
+
+    if (!map(size)) {
+        close();
+        return false;
+    }
+
+    quint64 offset = sizeof(header);
+    while (size - offset >= sizeof(RecordHeader)) {
+        RecordHeader record;
+        std::memcpy(&record, data + offset, sizeof(record));
+        if (record.length > size - offset - sizeof(record)) {
+            break;
+        }
+        index[TileCoord(record.x, record.y, record.zoom)] = Blob{offset + sizeof(record), record.length};
+        offset += sizeof(record) + record.length;
+    }
+
+    // Whatever follows the last whole record was cut short while appending
+    if (offset != size && (!file.resize(static_cast<qint64>(offset)) || !map(offset))) {
+        close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+void TilePack::close()
+{
+    if (file.isOpen()) {
+        flush();
+    }
+
+    QWriteLocker locker(&lock);
+    if (data) {
+        file.unmap(data);
+        data = nullptr;
+    }
+    mappedSize = 0;
+    index.clear();
+    file.close();
+
+    QMutexLocker queueLocker(&queueLock);
+    queued.clear();
+}
+
+int TilePack::tileCount() const
+{
+    QReadLocker locker(&lock);
+    return static_cast<int>(index.size());
+}
+
+bool TilePack::contains(const TileCoord& coord) const
+{
+    {
+        QReadLocker locker(&lock);
+        if (index.count(coord) > 0) {
+            return true;
+        }
+    }
+
+    QMutexLocker locker(&queueLock);
+    for (const auto& tile : queued) {
+        if (tile.first == coord) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QImage TilePack::read(const TileCoord& coord) const
+{
+    {
+        QReadLocker locker(&lock);
+        auto it = index.find(coord);
+        if (it != index.end()) {
+            return decode(data + it->second.offset, it->second.length, ratio);
+        }
+    }
+
+    // Written but not appended yet; the latest copy wins
+    QByteArray blob;
+    {
+        QMutexLocker locker(&queueLock);
+        for (auto it = queued.rbegin(); it != queued.rend(); ++it) {
+            if (it->first == coord) {
+                blob = it->second;
+                break;
+            }
+        }
+    }
+    if (blob.isEmpty()) {
+        return QImage();
+    }
+    return decode(reinterpret_cast<const uchar*>(blob.constData()), blob.size(), ratio);
+}
+
+void TilePack::write(const TileCoord& coord, const QImage& image)
+{
+    QByteArray blob;
+    QBuffer buffer(&blob);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "PNG")) {
+        return;
+    }
+
+    bool full;
+    {
+        QMutexLocker locker(&queueLock);
+        queued.emplace_back(coord, blob);
+        full = queued.size() >= static_cast<size_t>(BatchSize);
+    }
+    if (full) {
+        flush();
+    }
+}
+
+bool TilePack::flush()
+{
+    QMutexLocker fileLocker(&fileLock);
+
+    std::vector<std::pair<TileCoord, QByteArray>> batch;
+    {
+        QMutexLocker locker(&queueLock);
+        batch.swap(queued);
+    }
+    if (batch.empty() || !data) {
+        return data != nullptr;
+    }
+
+    // The whole batch goes out in one write, right after the mapped part
+    QByteArray bytes;
+    std::vector<std::pair<TileCoord, Blob>> added;
+    for (const auto& tile : batch) {
+        const RecordHeader record = {tile.first.x, tile.first.y, tile.first.zoom,
+                                     static_cast<quint32>(tile.second.size())};
+        bytes.append(reinterpret_cast<const char*>(&record), sizeof(record));
+        added.emplace_back(tile.first, Blob{mappedSize + bytes.size(), record.length});
+        bytes.append(tile.second);
+    }
+
+    // Once the pack is open only flush() remaps it, so under fileLock
+    // mappedSize is where the file ends
+    if (!file.seek(static_cast<qint64>(mappedSize)) || file.write(bytes) != bytes.size() ||
+        !file.flush()) {
+        // Drop the batch rather than leave a torn record behind
+        file.resize(static_cast<qint64>(mappedSize));
+        return false;
+    }
+
+    QWriteLocker locker(&lock);
+    if (!map(mappedSize + bytes.size())) {
+        // Nothing can be read, and further flushes are refused
+        index.clear();
+        return false;
+    }
+    for (const auto& tile : added) {
+        index[tile.first] = tile.second;
+    }
+    return true;
+}
+
+bool TilePack::map(quint64 size)
+{
+    if (data) {
+        file.unmap(data);
+        data = nullptr;
+    }
+    mappedSize = 0;
+
+    data = file.map(0, static_cast<qint64>(size));
+    if (!data) {
+        return false;
+    }
+    mappedSize = size;
+    return true;
+}
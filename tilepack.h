@@ -0,0 +1,84 @@
+#ifndef TILEPACK_H
+#define TILEPACK_H
+
+#include <QFile>
+#include <QImage>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QString>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "datatypes.h"
+
+// Rendered tiles kept in a single file across runs.
+//
+// The file is a header followed by records, each a tile coordinate and the
+// length of the PNG blob after it. Records are only ever appended, in
+// batches, and a later record for a tile replaces earlier ones. Opening a
+// pack walks the record headers to rebuild the tile -> blob index and maps
+// the file; tiles are decoded straight from the mapping.
+//
+// read(), write(), contains() and flush() may be called from any thread;
+// open() and close() only while no other call is running.
+class TilePack {
+public:
+    // Tiles queued by write() before they are appended together
+    static const int BatchSize = 64;
+
+    TilePack();
+    // Flushes queued tiles
+    ~TilePack();
+
+    // Where the pack for a pixel ratio lives, given the path of the 1x pack:
+    // "map.tiles" holds 1x tiles, "map@2x.tiles" 2x tiles and so on, so
+    // packs for different screens never replace each other
+    static QString pathFor(const QString& path, qreal pixelRatio);
+
+    // Opens the pack at path, creating it if needed. A pack written in
+    // another format is emptied, and a record torn by an interrupted append
+    // is cut off. Returns false if the file cannot be opened for reading
+    // and writing, or holds tiles for another pixel ratio.
+    bool open(const QString& path, qreal pixelRatio);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    QString path() const { return file.fileName(); }
+    qreal devicePixelRatio() const { return ratio; }
+    int tileCount() const;
+
+    bool contains(const TileCoord& coord) const;
+    // The stored tile, or a null image
+    QImage read(const TileCoord& coord) const;
+    // Encodes the tile and queues it, appending the queue once it holds
+    // BatchSize tiles
+    void write(const TileCoord& coord, const QImage& image);
+    // Appends the queued tiles in one write and maps the grown file
+    bool flush();
+
+private:
+    struct Blob {
+        quint64 offset;
+        quint32 length;
+    };
+
+    bool map(quint64 size);
+
+    QFile file;
+    qreal ratio;
+
+    // Guards the mapping and the index; readers share it while decoding
+    mutable QReadWriteLock lock;
+    uchar* data;
+    quint64 mappedSize;
+    std::unordered_map<TileCoord, Blob> index;
+
+    // Encoded tiles waiting to be appended
+    mutable QMutex queueLock;
+    std::vector<std::pair<TileCoord, QByteArray>> queued;
+
+    // Serializes appends to the file
+    QMutex fileLock;
+};
+
+#endif // TILEPACK_H
@@ -1,7 +0,0 @@
-#include "titlemanager.h"
-
-TileManager::TileManager(QObject *parent)
-    : QObject(parent)
-{
-    // Placeholder - will be used for loading map tiles in the future
-}
@@ -1,15 +0,0 @@
-#ifndef TILEMANAGER_H
-#define TILEMANAGER_H
-
-#include <QObject>
-
-class TileManager : public QObject {
-    Q_OBJECT
-
-public:
-    explicit TileManager(QObject *parent = nullptr);
-
-    // Placeholder for future tile loading functionality
-};
-
-#endif // TILEMANAGER_H